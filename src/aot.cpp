@@ -0,0 +1,416 @@
+/*
+    chip8-aot: ahead-of-time translator from a .ch8 ROM to a C++ translation
+    unit that registers itself with the CPU's Aot engine.
+
+    Usage: chip8-aot path/to/rom.ch8 output.cpp
+
+    The translator walks the program from PROGRAM_START_ADDRESS, following
+    jumps, skips and 2nnn/00EE call structure to find every reachable
+    instruction. Reachable code is split into basic blocks and emitted as
+    straight-line C++ with gotos between blocks, so the host compiler can
+    optimize across instructions. Computed jumps (Bnnn), returns and code
+    that was never discovered go through a PC switch, which hands control
+    back to the interpreter when it has no translation.
+*/
+
+#include "utilities.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+class AotTranslator {
+public:
+    AotTranslator(std::vector<uint8_t> rom, std::string name);
+
+    bool discover();                    // Recover the reachable control-flow graph
+    void emit(std::ostream& out) const; // Write the generated translation unit
+
+private:
+    std::vector<uint8_t> rom_;
+    std::string name_;
+
+    std::map<uint16_t, uint16_t> code_;    // Reachable address -> opcode
+    std::set<uint16_t> leaders_;            // Addresses that start a basic block
+
+    bool fetch(uint16_t address, uint16_t& opcode) const;
+    static bool is_valid(uint16_t opcode);
+    static bool ends_block(uint16_t opcode);
+
+    void emit_block(std::ostream& out, uint16_t leader) const;
+    void emit_instruction(std::ostream& out, uint16_t address, uint16_t opcode, size_t remaining) const;
+    std::string jump(uint16_t target) const;
+};
+
+AotTranslator::AotTranslator(std::vector<uint8_t> rom, std::string name)
+    : rom_(std::move(rom)),
+      name_(std::move(name)) {}
+
+bool AotTranslator::fetch(uint16_t address, uint16_t& opcode) const {
+    if (address < Utils::PROGRAM_START_ADDRESS)
+        return false;
+
+    size_t offset = address - Utils::PROGRAM_START_ADDRESS;
+    if (offset + 1 >= rom_.size())
+        return false;
+
+    opcode = rom_[offset] << 8 | rom_[offset + 1];
+    return true;
+}
+
+bool AotTranslator::is_valid(uint16_t opcode) {
+    switch (opcode >> 12) {
+        case 0x0:
+            // CHIP-8 and SUPER-CHIP; XO-CHIP programs (and their four byte
+            //  skips) are left to the interpreter
+            return opcode == 0x00E0 || opcode == 0x00EE || (opcode & 0xFFF0) == 0x00C0 ||
+                (opcode >= 0x00FB && opcode <= 0x00FF);
+        case 0x5:
+        case 0x9:
+            return (opcode & 0x000F) == 0;
+        case 0x8: {
+            uint8_t sub_op = opcode & 0x000F;
+            return sub_op <= 0x7 || sub_op == 0xE;
+        }
+        case 0xE:
+            return (opcode & 0x00FF) == 0x9E || (opcode & 0x00FF) == 0xA1;
+        case 0xF:
+            switch (opcode & 0x00FF) {
+                case 0x07: case 0x0A: case 0x15: case 0x18:
+                case 0x1E: case 0x29: case 0x33: case 0x55: case 0x65:
+                case 0x30: case 0x75: case 0x85:
+                    return true;
+                default:
+                    return false;
+            }
+        default:
+            return true;
+    }
+}
+
+bool AotTranslator::ends_block(uint16_t opcode) {
+    switch (opcode >> 12) {
+        case 0x0:
+            return opcode == 0x00EE || opcode == 0x00FD;
+        case 0x1: case 0x2: case 0x3: case 0x4:
+        case 0x5: case 0x9: case 0xB: case 0xE:
+            return true;
+        case 0xF:
+            return (opcode & 0x00FF) == 0x0A;
+        default:
+            return false;
+    }
+}
+
+bool AotTranslator::discover() {
+    std::vector<uint16_t> worklist = {Utils::PROGRAM_START_ADDRESS};
+    leaders_.insert(Utils::PROGRAM_START_ADDRESS);
+
+    while (!worklist.empty()) {
+        uint16_t address = worklist.back();
+        worklist.pop_back();
+
+        // Follow straight-line code until something redirects it
+        while (true) {
+            if (code_.contains(address)) {
+                // Ran into code found from another entry; start a block here
+                leaders_.insert(address);
+                break;
+            }
+
+            uint16_t opcode;
+            if (!fetch(address, opcode) || !is_valid(opcode))
+                break;
+            code_[address] = opcode;
+
+            uint16_t nnn = opcode & 0x0FFF;
+            auto branch_to = [&](uint16_t target) {
+                leaders_.insert(target);
+                worklist.push_back(target);
+            };
+
+            if (opcode == 0x00EE || (opcode >> 12) == 0xB) {
+                // Return or computed jump: resolved at runtime
+                break;
+            } else if (opcode == 0x00FD) {
+                // Exit: nothing runs after it
+                break;
+            } else if ((opcode >> 12) == 0x1) {
+                branch_to(nnn);
+                break;
+            } else if ((opcode >> 12) == 0x2) {
+                // Call: the target and the return site both start blocks
+                branch_to(nnn);
+                branch_to(address + 2);
+                break;
+            } else if ((opcode & 0xF0FF) == 0xF00A) {
+                // Key wait re-executes itself until a key arrives
+                branch_to(address);
+                branch_to(address + 2);
+                break;
+            } else if (ends_block(opcode)) {
+                // Skips
+                branch_to(address + 2);
+                branch_to(address + 4);
+                break;
+            }
+            address += 2;
+        }
+    }
+
+    // Drop leaders that never decoded to an instruction
+    std::erase_if(leaders_, [this](uint16_t leader) { return !code_.contains(leader); });
+    return !code_.empty();
+}
+
+std::string AotTranslator::jump(uint16_t target) const {
+    char buffer[64];
+    if (leaders_.contains(target)) {
+        std::snprintf(buffer, sizeof(buffer), "goto L_%03X;", target);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "{ ctx.pc = 0x%03X; goto dispatch; }", target);
+    }
+    return buffer;
+}
+
+void AotTranslator::emit_instruction(std::ostream& out, uint16_t address, uint16_t opcode, size_t remaining) const {
+    char line[256];
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t nn = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+
+    auto put = [&](const char* format, auto... args) {
+        std::snprintf(line, sizeof(line), format, args...);
+        out << "    " << line << "\n";
+    };
+
+    // Stateful or quirk-dependent ops go through the interpreter's handler
+    auto interpret = [&]() {
+        put("ctx.pc = 0x%03X; ctx.execute(0x%04X);", address, opcode);
+    };
+
+    put("// %03X: %04X", address, opcode);
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00EE) {
+                put("ctx.pc = ctx.ret() + 2; goto dispatch;");
+            } else if (opcode == 0x00FD) {
+                interpret();
+                put("goto dispatch;");
+            } else {
+                interpret();
+            }
+            break;
+        case 0x1:
+            put("%s", jump(nnn).c_str());
+            break;
+        case 0x2:
+            put("ctx.call(0x%03X); %s", address, jump(nnn).c_str());
+            break;
+        case 0x3:
+            put("if (v[0x%X] == 0x%02X) %s", x, nn, jump(address + 4).c_str());
+            put("%s", jump(address + 2).c_str());
+            break;
+        case 0x4:
+            put("if (v[0x%X] != 0x%02X) %s", x, nn, jump(address + 4).c_str());
+            put("%s", jump(address + 2).c_str());
+            break;
+        case 0x5:
+            put("if (v[0x%X] == v[0x%X]) %s", x, y, jump(address + 4).c_str());
+            put("%s", jump(address + 2).c_str());
+            break;
+        case 0x9:
+            put("if (v[0x%X] != v[0x%X]) %s", x, y, jump(address + 4).c_str());
+            put("%s", jump(address + 2).c_str());
+            break;
+        case 0x6:
+            put("v[0x%X] = 0x%02X;", x, nn);
+            break;
+        case 0x7:
+            put("v[0x%X] += 0x%02X;", x, nn);
+            break;
+        case 0x8:
+            switch (opcode & 0x000F) {
+                case 0x0:
+                    put("v[0x%X] = v[0x%X];", x, y);
+                    break;
+                case 0x4:
+                    put("{ bool carry = v[0x%X] > UINT8_MAX - v[0x%X]; v[0x%X] += v[0x%X]; v[0xF] = carry; }", x, y, x, y);
+                    break;
+                case 0x5:
+                    put("{ bool borrow = v[0x%X] < v[0x%X]; v[0x%X] -= v[0x%X]; v[0xF] = !borrow; }", x, y, x, y);
+                    break;
+                case 0x7:
+                    put("{ bool borrow = v[0x%X] > v[0x%X]; v[0x%X] = v[0x%X] - v[0x%X]; v[0xF] = !borrow; }", x, y, x, y, x);
+                    break;
+                default:
+                    interpret();
+                    break;
+            }
+            break;
+        case 0xA:
+            put("ctx.i = 0x%03X;", nnn);
+            break;
+        case 0xB:
+            interpret();
+            put("goto dispatch;");
+            break;
+        case 0xE:
+            put("if (%sctx.peripherals.key_state[v[0x%X]]) %s", (nn == 0x9E) ? "" : "!", x, jump(address + 4).c_str());
+            put("%s", jump(address + 2).c_str());
+            break;
+        case 0xF:
+            switch (nn) {
+                case 0x07:
+                    put("v[0x%X] = ctx.delay_timer.get();", x);
+                    break;
+                case 0x15:
+                    put("ctx.delay_timer.set(v[0x%X]);", x);
+                    break;
+                case 0x18:
+                    put("ctx.sound_timer.set(v[0x%X]);", x);
+                    break;
+                case 0x0A:
+                    interpret();
+                    put("goto dispatch;");
+                    break;
+                case 0x33:
+                case 0x55:
+                    // Memory writes may hit translated code; bail out if so
+                    interpret();
+                    put("if (ctx.check_code_writes()) { executed -= %zu; return executed; }", remaining);
+                    break;
+                default:
+                    interpret();
+                    break;
+            }
+            break;
+        default:
+            interpret();
+            break;
+    }
+}
+
+void AotTranslator::emit_block(std::ostream& out, uint16_t leader) const {
+    // Gather the straight-line run belonging to this block
+    std::vector<std::pair<uint16_t, uint16_t>> block;
+    uint16_t address = leader;
+    while (code_.contains(address) && (address == leader || !leaders_.contains(address))) {
+        uint16_t opcode = code_.at(address);
+        block.emplace_back(address, opcode);
+        if (ends_block(opcode))
+            break;
+        address += 2;
+    }
+
+    uint16_t length = block.size() * 2;
+    out << "L_" << std::hex << std::uppercase << leader << std::dec << ":\n";
+    out << "    if (executed + " << block.size() << " > cycles) { ctx.pc = 0x" << std::hex << leader << std::dec << "; return executed; }\n";
+    out << "    if (ctx.code_modified() && !ctx.code_intact(0x" << std::hex << leader << std::dec
+        << ", ROM + " << (leader - Utils::PROGRAM_START_ADDRESS) << ", " << length << ")) { ctx.pc = 0x"
+        << std::hex << leader << std::dec << "; return executed; }\n";
+    out << "    executed += " << block.size() << ";\n";
+
+    for (size_t op_idx = 0; op_idx < block.size(); op_idx++) {
+        emit_instruction(out, block[op_idx].first, block[op_idx].second, block.size() - op_idx - 1);
+    }
+
+    // Fell through into the next block
+    if (!ends_block(block.back().second))
+        out << "    " << jump(block.back().first + 2) << "\n";
+    out << "\n";
+}
+
+void AotTranslator::emit(std::ostream& out) const {
+    out << "// Generated by chip8-aot from " << name_ << ".ch8 -- do not edit\n\n";
+    out << "#include \"cpu.h\"\n\n";
+    out << "#include <cstdint>\n\n";
+    out << "namespace {\n\n";
+
+    out << "const uint8_t ROM[] = {";
+    for (size_t offset = 0; offset < rom_.size(); offset++) {
+        out << ((offset % 16) ? " " : "\n    ") << static_cast<int>(rom_[offset]) << ",";
+    }
+    out << "\n};\n\n";
+
+    // Translated code ranges, merged where contiguous
+    out << "const CPU::AotCodeRange CODE_RANGES[] = {\n";
+    size_t range_count = 0;
+    for (auto iter = code_.begin(); iter != code_.end();) {
+        uint16_t start = iter->first;
+        uint16_t end = start + 2;
+        for (++iter; iter != code_.end() && iter->first <= end; ++iter) {
+            end = std::max<uint16_t>(end, iter->first + 2);
+        }
+        out << "    {0x" << std::hex << start << ", 0x" << end << std::dec << "},\n";
+        range_count++;
+    }
+    out << "};\n\n";
+
+    out << "uint32_t run(CPU::AotContext& ctx, uint32_t cycles) {\n";
+    out << "    [[maybe_unused]] uint8_t* v = ctx.v;   // Unused when every op calls into the CPU\n";
+    out << "    uint32_t executed = 0;\n\n";
+    out << "[[maybe_unused]] dispatch:\n";
+    out << "    switch (ctx.pc) {\n";
+    for (uint16_t leader : leaders_) {
+        out << "        case 0x" << std::hex << leader << ": goto L_" << std::uppercase << leader << std::nouppercase << std::dec << ";\n";
+    }
+    out << "        default: return executed;   // Not translated, let the interpreter take over\n";
+    out << "    }\n\n";
+
+    for (uint16_t leader : leaders_) {
+        emit_block(out, leader);
+    }
+    out << "}\n\n";
+
+    out << "const CPU::AotProgram PROGRAM = {\n";
+    out << "    \"" << name_ << "\",\n";
+    out << "    0x" << std::hex << Utils::fnv1a(rom_.data(), rom_.size()) << std::dec << ",\n";
+    out << "    " << rom_.size() << ",\n";
+    out << "    &run,\n";
+    out << "    CODE_RANGES,\n";
+    out << "    " << range_count << ",\n";
+    out << "};\n\n";
+    out << "[[maybe_unused]] const bool registered = CPU::register_aot_program(&PROGRAM);\n\n";
+    out << "}\n";
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::fprintf(stderr, "Usage: chip8-aot path/to/rom.ch8 output.cpp\n");
+        return 1;
+    }
+
+    std::ifstream rom_file(argv[1], std::ios::binary);
+    if (!rom_file) {
+        std::fprintf(stderr, "Failed to open ROM %s\n", argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(rom_file)), std::istreambuf_iterator<char>());
+
+    if (rom.size() + Utils::PROGRAM_START_ADDRESS > Utils::MEMORY_SIZE) {
+        std::fprintf(stderr, "ROM %s does not fit in memory\n", argv[1]);
+        return 1;
+    }
+
+    AotTranslator translator(std::move(rom), std::filesystem::path(argv[1]).stem().string());
+    if (!translator.discover()) {
+        std::fprintf(stderr, "No code found in ROM %s\n", argv[1]);
+        return 1;
+    }
+
+    std::ofstream output(argv[2]);
+    if (!output) {
+        std::fprintf(stderr, "Failed to open output %s\n", argv[2]);
+        return 1;
+    }
+    translator.emit(output);
+    return 0;
+}
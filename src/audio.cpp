@@ -0,0 +1,146 @@
+#include "audio.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Phase step for a waveform that repeats `hz` times per second
+    uint32_t phase_step(double hz, uint32_t sample_rate) {
+        return static_cast<uint32_t>(std::llround(hz * 4294967296.0 / sample_rate));
+    }
+}
+
+Audio::Audio(uint32_t sample_rate, uint32_t latency)
+    : sample_rate_(sample_rate),
+      latency_(latency),
+      step_(phase_step(Utils::BEEP_TONE_HZ, sample_rate))
+{
+    // One period of the tone, computed once instead of per sample
+    for (size_t idx = 0; idx < WAVETABLE_SIZE; idx++) {
+        double phase = 2.0 * M_PI * idx / WAVETABLE_SIZE;
+        tone_table_[idx] = static_cast<int16_t>(std::lround(Utils::BEEP_AMPLITUDE * std::sin(phase) * INT16_MAX));
+    }
+}
+
+/*
+    Producer Side
+*/
+int64_t Audio::frame_time(uint64_t frame) const {
+    return static_cast<int64_t>(frame * sample_rate_ / Utils::TIMER_CYCLE_HZ);
+}
+
+void Audio::beep(uint64_t frame, bool enable) {
+    // A pattern change that found the ring full goes first
+    if (has_pending_pattern_ && events_.push(pending_pattern_))
+        has_pending_pattern_ = false;
+
+    // Edges are queued, plus the current state every so often so the
+    //  callback can notice the clocks drifting apart while nothing changes.
+    //  If the ring is full the event is simply tried again next frame.
+    if (queued_any_ && enable == queued_enable_ && frame < queued_frame_ + KEEPALIVE_FRAMES)
+        return;
+    Event event;
+    event.time = frame_time(frame);
+    event.enable = enable;
+    if (events_.push(event)) {
+        queued_enable_ = enable;
+        queued_any_ = true;
+        queued_frame_ = frame;
+    }
+}
+
+void Audio::pattern(uint64_t frame, const Backend::AudioPattern& pattern, uint8_t pitch) {
+    Event event;
+    event.time = frame_time(frame);
+    event.enable = queued_enable_;
+    event.set_pattern = true;
+    event.pitch = pitch;
+    event.pattern = pattern;
+    if (!events_.push(event)) {
+        pending_pattern_ = event;
+        has_pending_pattern_ = true;
+    }
+}
+
+/*
+    Consumer Side
+*/
+void Audio::render(int16_t* out, size_t samples) {
+    const int64_t drift_limit = 4 * latency_;
+    int64_t length = static_cast<int64_t>(samples);
+    int64_t done = 0;
+
+    while (const Event* event = events_.peek()) {
+        int64_t offset = event->time - cursor_;
+
+        // The first event, or emulated time running off from the device's
+        //  (speed change, stall), lines the cursor up again so the event
+        //  plays one buffer from now
+        if (!anchored_.load(std::memory_order_relaxed) || offset > latency_ + drift_limit || offset < -drift_limit) {
+            cursor_ = event->time - latency_ - done;
+            offset = latency_ + done;
+            anchored_.store(true, std::memory_order_relaxed);
+        }
+        if (offset >= length)
+            break;
+
+        // Late events take effect right away
+        if (offset > done) {
+            synthesize(out + done, static_cast<size_t>(offset - done));
+            done = offset;
+        }
+        apply(*event);
+        events_.pop();
+    }
+
+    synthesize(out + done, static_cast<size_t>(length - done));
+    cursor_ += length;
+    played_.store(cursor_, std::memory_order_release);
+}
+
+bool Audio::lead(uint64_t frame, int64_t& samples) const {
+    int64_t played = played_.load(std::memory_order_acquire);
+    if (!anchored_.load(std::memory_order_relaxed))
+        return false;
+    samples = frame_time(frame) - played;
+    return true;
+}
+
+void Audio::apply(const Event& event) {
+    playing_ = event.enable;
+    if (!event.set_pattern)
+        return;
+
+    // Each pattern bit (MSB first) covers two table entries, high or low
+    int16_t amplitude = static_cast<int16_t>(Utils::BEEP_AMPLITUDE * INT16_MAX);
+    constexpr size_t entries_per_bit = WAVETABLE_SIZE / (Utils::AUDIO_PATTERN_BYTES * 8);
+    for (size_t idx = 0; idx < WAVETABLE_SIZE; idx++) {
+        size_t bit = idx / entries_per_bit;
+        bool high = (event.pattern[bit / 8] >> (7 - bit % 8)) & 0x1;
+        pattern_table_[idx] = high ? amplitude : static_cast<int16_t>(-amplitude);
+    }
+    table_ = pattern_table_.data();
+
+    // Bits play at 4000 * 2^((pitch - 64) / 48) Hz, the whole pattern
+    //  repeating every 128 bits
+    double bit_rate = Utils::AUDIO_PATTERN_BASE_HZ * std::exp2((event.pitch - Utils::AUDIO_PATTERN_BASE_PITCH) / 48.0);
+    step_ = phase_step(bit_rate / (Utils::AUDIO_PATTERN_BYTES * 8), sample_rate_);
+}
+
+void Audio::synthesize(int16_t* out, size_t samples) {
+    uint32_t phase = phase_;
+    uint32_t step = step_;
+    phase_ += static_cast<uint32_t>(samples) * step;
+
+    if (!playing_) {
+        std::fill_n(out, samples, int16_t{0});
+        return;
+    }
+
+    // Nearest-sample resampling of the wavetable. No branches or carried
+    //  state inside the loop, so the compiler vectorizes it.
+    const int16_t* table = table_;
+    for (size_t idx = 0; idx < samples; idx++) {
+        uint32_t sample_phase = phase + static_cast<uint32_t>(idx) * step;
+        out[idx] = table[sample_phase >> WAVETABLE_SHIFT];
+    }
+}
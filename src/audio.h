@@ -0,0 +1,77 @@
+#pragma once
+
+#include "backend.h"
+#include "spsc_ring.h"
+#include "utilities.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Beeper sound, independent of the audio device. The emulation thread
+//  queues timestamped changes (beeper on/off, XO-CHIP pattern and pitch)
+//  and the device's callback thread renders them at the matching sample.
+//  The two threads share nothing but a lock-free single-producer/single-
+//  consumer ring.
+//
+// Output comes from a wavetable read with a 32-bit phase accumulator: a
+//  sine for the plain tone, or the 1-bit pattern expanded to the same
+//  size. The phase carries over between callbacks and while silent, so
+//  buffer boundaries don't click.
+class Audio {
+    public:
+        explicit Audio(uint32_t sample_rate = Utils::AUDIO_RATE_HZ, uint32_t latency = Utils::AUDIO_BUFFER_SIZE);
+
+        // Producer side (emulation thread)
+        void beep(uint64_t frame, bool enable);
+        void pattern(uint64_t frame, const Backend::AudioPattern& pattern, uint8_t pitch);
+
+        // Samples of emulated time queued ahead of the device at this frame.
+        //  False until the first event has been played against.
+        bool lead(uint64_t frame, int64_t& samples) const;
+
+        // Consumer side (audio callback): fill the next samples
+        void render(int16_t* out, size_t samples);
+
+    private:
+        static constexpr size_t WAVETABLE_SIZE = 256;
+        static constexpr int WAVETABLE_SHIFT = 24;     // Phase bits above the table index
+        static constexpr size_t RING_SIZE = 64;
+        static constexpr uint64_t KEEPALIVE_FRAMES = 30;   // Longest gap between queued events
+
+        struct Event {
+            int64_t time = 0;       // Emulated time in samples
+            bool enable = false;
+            bool set_pattern = false;
+            uint8_t pitch = 0;
+            Backend::AudioPattern pattern = {};
+        };
+
+        const uint32_t sample_rate_;
+        const int64_t latency_;     // Samples between an event's arrival and its playback
+        SpscRing<Event, RING_SIZE> events_;
+
+        // Producer state
+        bool queued_enable_ = false;    // Beeper state as last queued
+        bool queued_any_ = false;
+        uint64_t queued_frame_ = 0;     // Frame of the last queued beeper event
+        Event pending_pattern_ = {};    // Pattern change still waiting for room in the ring
+        bool has_pending_pattern_ = false;
+
+        // Consumer state
+        std::array<int16_t, WAVETABLE_SIZE> tone_table_;
+        std::array<int16_t, WAVETABLE_SIZE> pattern_table_ = {};
+        const int16_t* table_ = tone_table_.data();
+        uint32_t phase_ = 0;
+        uint32_t step_;                 // Phase advance per sample
+        bool playing_ = false;
+        int64_t cursor_ = 0;            // Emulated time of the next sample to render
+
+        // Published by the consumer for lead()
+        std::atomic<bool> anchored_{false};     // cursor_ has been lined up with emulated time
+        std::atomic<int64_t> played_{0};        // cursor_ as of the last render
+
+        int64_t frame_time(uint64_t frame) const;
+        void apply(const Event& event);
+        void synthesize(int16_t* out, size_t samples);
+};
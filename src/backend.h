@@ -0,0 +1,81 @@
+#pragma once
+
+#include "framebuffer.h"
+#include "utilities.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+class Peripherals;
+class Telemetry;
+
+// Emulation speed relative to the 60 Hz frame rate (real-time backends only)
+enum class Speed {
+    Normal,         // 1x
+    Double,         // 2x
+    Unthrottled,    // As fast as the host allows
+    SlowMotion,     // 0.5x
+};
+
+// Host side of the emulator: display output, audio, input and wall-clock
+//  timing. Peripherals owns one and forwards to it, so the rest of the
+//  emulator never talks to SDL (or anything else host specific) directly.
+class Backend {
+    public:
+        using Framebuffer = ::Framebuffer;
+        using AudioPattern = std::array<uint8_t, Utils::AUDIO_PATTERN_BYTES>;
+
+        virtual ~Backend() = default;
+
+        // Display and audio. Audio calls are stamped with the emulated frame
+        //  they take effect on, so the host can place them on its own clock.
+        virtual void present(const Framebuffer& pixels) = 0;
+        virtual void beep(uint64_t frame, bool enable) = 0;
+        // XO-CHIP: play a 1-bit pattern instead of the tone (pitch 64 = 4000 Hz)
+        virtual void audio_pattern(uint64_t, const AudioPattern&, uint8_t) {}
+
+        // Deliver input due by this frame through Peripherals::key_event.
+        //  Returns true if the emulator should quit.
+        virtual bool poll_input(uint64_t frame, Peripherals& peripherals) = 0;
+
+        // Earliest frame poll_input could deliver anything on. Interactive
+        //  backends can't know, so input may arrive on the very next poll.
+        virtual uint64_t next_input_frame() const { return 0; }
+
+        // The program's keypad was put back to `keys` (one bit per key),
+        //  e.g. by a rewind. Backends that only report key changes should
+        //  report whatever the real keys now differ by on the next poll.
+        virtual void keys_restored(uint16_t) {}
+
+        // Speed change asked for by the user since the last call, if any
+        virtual bool take_speed_request(Speed&) { return false; }
+
+        // True while the user holds the key that steps back in time
+        virtual bool rewind_held() const { return false; }
+
+        // Timing: real-time backends are throttled to the wall clock,
+        //  others run as fast as the host allows
+        virtual bool real_time() const = 0;
+        virtual uint64_t ticks() const = 0;             // Current wall-clock tick
+        virtual uint64_t tick_frequency() const = 0;    // Ticks per second
+        virtual void delay(uint32_t ms) = 0;
+
+        // Sleep until input arrives or ms pass, returns true on input
+        virtual bool wait_input(uint32_t ms) { delay(ms); return false; }
+
+        // Audio clock: samples of emulated time queued ahead of the audio
+        //  device at this frame. False if there is no audio clock (yet).
+        virtual bool audio_lead(uint64_t, int64_t&) const { return false; }
+
+        // Host-side timings (drawing, input to display) and counters are
+        //  recorded here, if the backend measures any
+        virtual void set_telemetry(Telemetry*) {}
+
+        // Hosts with a UI event loop (window, renderer, event pump) run it
+        //  in run_ui on the thread that called Emulator::run, while the
+        //  emulator runs on a thread of its own. run_ui returns once
+        //  `finished` is set; everything else above is called from the
+        //  emulation thread.
+        virtual bool runs_ui() const { return false; }
+        virtual void run_ui(const std::atomic<bool>&) {}
+};
@@ -0,0 +1,461 @@
+/*
+    chip8-batch: runs many headless emulator instances across all cores.
+
+    Usage: chip8-batch jobs.txt [--threads=N] [--engine=interpreter|cached|jit|aot] [--lockstep]
+
+    Job list format, one job per line ('#' starts a comment):
+        <rom.ch8> <input script|-> frames=N|cycles=N <output.pbm|-> [seed=N] [state=file[:N]]
+            [profile=NAME] [cycles-per-frame=N]
+
+    profile= picks the quirk profile (vip, chip48, schip, xochip, modern);
+    by default it follows the ROM's extension, as it does for chip8.
+
+    state= starts the job from a checkpoint in a save state file instead of
+    from reset; the budget still counts from reset. Each state file is
+    mapped once and shared by every job that uses it.
+
+    With --lockstep, jobs that share a ROM, budget, profile and speed run as up to 32 SIMD
+    lanes of one Lockstep engine instead of one emulator each.
+
+    One result line per job is written to stdout, in job order:
+        <job> <rom> <frames> <cycles> <framebuffer hash> <wall ms> <status>
+*/
+
+#include "emulator.h"
+#include "headless_backend.h"
+#include "lockstep.h"
+#include "save_state.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+struct Job {
+    std::string rom_path;
+    std::string input_script;   // Empty for no input
+    uint64_t max_frames = 0;
+    uint64_t max_cycles = 0;
+    std::string output_path;    // Empty for no framebuffer dump
+    uint32_t seed = 0;          // Cxnn random seed, 0 for the default
+    std::string state_path;     // Empty to start from reset
+    size_t state_index = 0;
+    Profile profile = Profile::Modern;
+    uint32_t cycles_per_frame = Utils::CYCLES_PER_FRAME;
+};
+
+// Mapped state files by path, shared read-only by every worker
+using StateFiles = std::map<std::string, std::unique_ptr<MappedStates>>;
+
+struct JobResult {
+    uint64_t frames = 0;
+    uint64_t cycles = 0;
+    uint32_t framebuffer_hash = 0;
+    double wall_ms = 0.0;
+    std::string status = "ok";
+};
+
+// Fixed set of workers, each with its own queue of job indices. A worker
+//  takes from the back of its own queue and, once that runs dry, steals
+//  from the front of the others', so uneven jobs still keep every core busy.
+class WorkStealingPool {
+public:
+    WorkStealingPool(size_t worker_count, size_t job_count);
+
+    template <typename Fn>
+    void run(Fn&& run_job);
+
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+    };
+    std::vector<WorkQueue> queues_;
+
+    bool take(size_t worker, size_t& job);
+};
+
+WorkStealingPool::WorkStealingPool(size_t worker_count, size_t job_count)
+    : queues_(worker_count) {
+    // Deal the jobs out round-robin
+    for (size_t job = 0; job < job_count; job++) {
+        queues_[job % worker_count].jobs.push_back(job);
+    }
+}
+
+bool WorkStealingPool::take(size_t worker, size_t& job) {
+    {
+        WorkQueue& own = queues_[worker];
+        std::lock_guard lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // Jobs are never added after start, so one empty sweep means we're done
+    for (size_t offset = 1; offset < queues_.size(); offset++) {
+        WorkQueue& victim = queues_[(worker + offset) % queues_.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Fn>
+void WorkStealingPool::run(Fn&& run_job) {
+    std::vector<std::thread> workers;
+    for (size_t worker = 0; worker < queues_.size(); worker++) {
+        workers.emplace_back([this, worker, &run_job]() {
+            size_t job;
+            while (take(worker, job)) {
+                run_job(job);
+            }
+        });
+    }
+    for (std::thread& thread : workers) {
+        thread.join();
+    }
+}
+
+static std::vector<Job> load_jobs(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Failed to open job list " + path);
+
+    std::vector<Job> jobs;
+    std::string line;
+    for (uint32_t line_num = 1; std::getline(file, line); line_num++) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+
+        Job job;
+        std::string input, budget, output;
+        if (!(fields >> job.rom_path))
+            continue;
+        if (!(fields >> input >> budget >> output))
+            throw std::runtime_error("Job list line " + std::to_string(line_num) + ": expected <rom> <input> <budget> <output>");
+
+        job.profile = default_profile(std::filesystem::path(job.rom_path).extension().string());
+        if (input != "-")
+            job.input_script = input;
+        if (output != "-")
+            job.output_path = output;
+
+        if (budget.starts_with("frames=")) {
+            job.max_frames = std::stoull(budget.substr(std::string("frames=").size()));
+        } else if (budget.starts_with("cycles=")) {
+            job.max_cycles = std::stoull(budget.substr(std::string("cycles=").size()));
+        }
+        if (job.max_frames == 0 && job.max_cycles == 0)
+            throw std::runtime_error("Job list line " + std::to_string(line_num) + ": budget must be frames=N or cycles=N");
+
+        std::string option;
+        while (fields >> option) {
+            if (option.starts_with("seed=")) {
+                job.seed = std::stoul(option.substr(std::string("seed=").size()));
+            } else if (option.starts_with("state=")) {
+                parse_state_spec(option.substr(std::string("state=").size()), job.state_path, job.state_index);
+            } else if (option.starts_with("profile=")) {
+                if (!parse_profile(option.substr(std::string("profile=").size()), job.profile))
+                    throw std::runtime_error("Job list line " + std::to_string(line_num) + ": unknown " + option);
+            } else if (option.starts_with("cycles-per-frame=")) {
+                job.cycles_per_frame = std::stoul(option.substr(std::string("cycles-per-frame=").size()));
+            } else {
+                throw std::runtime_error("Job list line " + std::to_string(line_num) + ": expected seed=N, state=file[:N], profile=NAME or cycles-per-frame=N");
+            }
+        }
+
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+static void write_pbm(const std::string& path, const Backend::Framebuffer& pixels) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Failed to open output " + path);
+
+    // Raw PBM rows are packed MSB-first; a pixel is set if it is lit on
+    //  any plane
+    out << "P4\n" << pixels.width() << " " << pixels.height() << "\n";
+    for (uint16_t y = 0; y < pixels.height(); y++) {
+        for (uint16_t x = 0; x < pixels.width(); x += 8) {
+            uint8_t byte = 0;
+            for (uint16_t bit = 0; bit < 8; bit++) {
+                byte = static_cast<uint8_t>(byte << 1 | (pixels.pixel(x + bit, y) != 0));
+            }
+            out.put(static_cast<char>(byte));
+        }
+    }
+}
+
+static std::unique_ptr<Backend> make_backend(const Job& job) {
+    if (job.input_script.empty())
+        return std::make_unique<HeadlessBackend>();
+    return std::make_unique<HeadlessBackend>(job.input_script);
+}
+
+static uint32_t hash_framebuffer(const Backend::Framebuffer& pixels) {
+    // A plain CHIP-8 screen hashes as its 32 packed rows, as it always has,
+    //  so results stay comparable with earlier runs
+    if (pixels.lores_single_plane()) {
+        std::array<uint64_t, Utils::PIXEL_HEIGHT> rows;
+        for (uint16_t y = 0; y < Utils::PIXEL_HEIGHT; y++) {
+            rows[y] = pixels.row(0, y)[0];
+        }
+        return Utils::fnv1a(reinterpret_cast<const uint8_t*>(rows.data()), sizeof(rows));
+    }
+
+    std::vector<uint8_t> bytes;
+    for (size_t plane = 0; plane < Backend::Framebuffer::PLANES; plane++) {
+        for (uint16_t y = 0; y < Backend::Framebuffer::ROWS; y++) {
+            const auto& row = pixels.row(plane, y);
+            const auto* data = reinterpret_cast<const uint8_t*>(row.data());
+            bytes.insert(bytes.end(), data, data + sizeof(row));
+        }
+    }
+    return Utils::fnv1a(bytes.data(), bytes.size());
+}
+
+static JobResult run_job(const Job& job, CPU::Engine engine, const StateFiles& state_files) {
+    JobResult result;
+    auto start = std::chrono::steady_clock::now();
+
+    try {
+        Emulator emulator(make_backend(job));
+        emulator.set_cpu_engine(engine);
+        emulator.set_profile(job.profile);
+        emulator.set_cycles_per_frame(job.cycles_per_frame);
+        if (job.seed != 0)
+            emulator.seed(job.seed);
+        emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+        emulator.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
+        emulator.load_rom(job.rom_path);
+        if (!job.state_path.empty()) {
+            const MappedStates& states = *state_files.at(job.state_path);
+            if (job.state_index >= states.size())
+                throw std::runtime_error(job.state_path + " holds only " + std::to_string(states.size()) + " states");
+            emulator.load_state(states[job.state_index]);
+        }
+        emulator.run(job.max_frames, job.max_cycles);
+
+        const auto& pixels = emulator.peripherals().framebuffer;
+        result.frames = emulator.frame();
+        result.cycles = emulator.cycles();
+        result.framebuffer_hash = hash_framebuffer(pixels);
+
+        if (!job.output_path.empty())
+            write_pbm(job.output_path, pixels);
+    } catch (const std::exception& error) {
+        result.status = std::string("error: ") + error.what();
+    }
+
+    result.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Lockstep totals across every group, reported once at the end
+struct LockstepStats {
+    std::atomic<uint64_t> lockstep_cycles = 0;
+    std::atomic<uint64_t> per_lane_cycles = 0;
+    std::atomic<uint64_t> divergences = 0;
+};
+
+// Jobs that can share a Lockstep engine: same ROM, budget, profile and
+//  cycles per frame, at most 32.
+//  Jobs resuming from a save state run on their own.
+static std::vector<std::vector<size_t>> group_jobs(const std::vector<Job>& jobs) {
+    std::vector<std::vector<size_t>> groups;
+    std::map<std::tuple<std::string, uint64_t, uint64_t, Profile, uint32_t>, std::vector<size_t>> by_program;
+    for (size_t job = 0; job < jobs.size(); job++) {
+        if (!jobs[job].state_path.empty()) {
+            groups.push_back({job});
+            continue;
+        }
+        const Job& program = jobs[job];
+        by_program[{program.rom_path, program.max_frames, program.max_cycles, program.profile, program.cycles_per_frame}].push_back(job);
+    }
+
+    for (const auto& [program, members] : by_program) {
+        for (size_t first = 0; first < members.size(); first += 32) {
+            size_t last = std::min(first + 32, members.size());
+            groups.emplace_back(members.begin() + first, members.begin() + last);
+        }
+    }
+    return groups;
+}
+
+template <size_t Lanes>
+static void run_lockstep_group(const std::vector<Job>& jobs, const std::vector<size_t>& group, CPU::Engine engine,
+                               std::vector<JobResult>& results, LockstepStats& stats) {
+    auto start = std::chrono::steady_clock::now();
+    const Job& first = jobs[group.front()];
+    std::string status = "ok";
+
+    try {
+        std::vector<std::unique_ptr<Backend>> backends;
+        for (size_t job : group) {
+            backends.push_back(make_backend(jobs[job]));
+        }
+
+        // Lanes past the end of the group are left unused
+        Lockstep<Lanes> lockstep(std::move(backends));
+        for (size_t lane = group.size(); lane < Lanes; lane++) {
+            lockstep.retire(lane);
+        }
+        lockstep.set_cpu_engine(engine);
+        lockstep.set_profile(first.profile);
+        lockstep.set_cycles_per_frame(first.cycles_per_frame);
+        lockstep.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+        lockstep.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
+        lockstep.load_rom(first.rom_path);
+        for (size_t lane = 0; lane < group.size(); lane++) {
+            if (jobs[group[lane]].seed != 0)
+                lockstep.seed(lane, jobs[group[lane]].seed);
+        }
+        lockstep.run(first.max_frames, first.max_cycles);
+
+        for (size_t lane = 0; lane < group.size(); lane++) {
+            const Job& job = jobs[group[lane]];
+            JobResult& result = results[group[lane]];
+            Backend::Framebuffer pixels = lockstep.framebuffer(lane);
+
+            result.frames = lockstep.frames(lane);
+            result.cycles = lockstep.cycles(lane);
+            result.framebuffer_hash = hash_framebuffer(pixels);
+            if (!job.output_path.empty())
+                write_pbm(job.output_path, pixels);
+        }
+
+        stats.lockstep_cycles += lockstep.lockstep_cycles();
+        stats.per_lane_cycles += lockstep.per_lane_cycles();
+        stats.divergences += lockstep.divergences();
+    } catch (const std::exception& error) {
+        status = std::string("error: ") + error.what();
+    }
+
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    for (size_t job : group) {
+        results[job].wall_ms = wall_ms;
+        if (status != "ok")
+            results[job].status = status;
+    }
+}
+
+static void run_lockstep(const std::vector<Job>& jobs, const std::vector<size_t>& group, CPU::Engine engine,
+                         const StateFiles& state_files, std::vector<JobResult>& results, LockstepStats& stats) {
+    if (!jobs[group.front()].state_path.empty()) {
+        results[group.front()] = run_job(jobs[group.front()], engine, state_files);
+    } else if (group.size() <= 8) {
+        run_lockstep_group<8>(jobs, group, engine, results, stats);
+    } else if (group.size() <= 16) {
+        run_lockstep_group<16>(jobs, group, engine, results, stats);
+    } else {
+        run_lockstep_group<32>(jobs, group, engine, results, stats);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: chip8-batch jobs.txt [--threads=N] [--engine=interpreter|cached|jit|aot] [--lockstep]\n");
+        return 1;
+    }
+
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+    CPU::Engine engine = CPU::Engine::Cached;
+    bool lockstep = false;
+    for (int arg_idx = 2; arg_idx < argc; arg_idx++) {
+        std::string arg(argv[arg_idx]);
+
+        if (arg.starts_with("--threads=")) {
+            thread_count = std::max<size_t>(1, std::stoul(arg.substr(std::string("--threads=").size())));
+        } else if (arg == "--engine=interpreter") {
+            engine = CPU::Engine::Interpreter;
+        } else if (arg == "--engine=cached") {
+            engine = CPU::Engine::Cached;
+        } else if (arg == "--engine=jit") {
+            engine = CPU::Engine::Jit;
+        } else if (arg == "--engine=aot") {
+            engine = CPU::Engine::Aot;
+        } else if (arg == "--lockstep") {
+            lockstep = true;
+        } else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 1;
+        }
+    }
+
+    std::vector<Job> jobs;
+    StateFiles state_files;
+    try {
+        jobs = load_jobs(argv[1]);
+        for (const Job& job : jobs) {
+            if (!job.state_path.empty() && !state_files.contains(job.state_path))
+                state_files[job.state_path] = std::make_unique<MappedStates>(job.state_path);
+        }
+    } catch (const std::exception& error) {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+
+    std::vector<JobResult> results(jobs.size());
+    auto start = std::chrono::steady_clock::now();
+
+    // Lockstep groups are the unit of work instead of single jobs
+    std::vector<std::vector<size_t>> groups;
+    LockstepStats stats;
+    if (lockstep)
+        groups = group_jobs(jobs);
+    size_t task_count = lockstep ? groups.size() : jobs.size();
+
+    size_t worker_count = std::min(thread_count, std::max<size_t>(1, task_count));
+    WorkStealingPool pool(worker_count, task_count);
+    if (lockstep) {
+        pool.run([&](size_t group) { run_lockstep(jobs, groups[group], engine, state_files, results, stats); });
+    } else {
+        pool.run([&](size_t job) { results[job] = run_job(jobs[job], engine, state_files); });
+    }
+
+    double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    bool all_ok = true;
+    for (size_t job = 0; job < jobs.size(); job++) {
+        const JobResult& result = results[job];
+        std::printf("%zu %s %llu %llu %08x %.3f %s\n", job, jobs[job].rom_path.c_str(),
+                    static_cast<unsigned long long>(result.frames),
+                    static_cast<unsigned long long>(result.cycles),
+                    result.framebuffer_hash, result.wall_ms, result.status.c_str());
+        all_ok &= (result.status == "ok");
+    }
+    std::fprintf(stderr, "%zu jobs on %zu threads in %.1f ms\n", jobs.size(), worker_count, wall_ms);
+    if (lockstep) {
+        uint64_t total_cycles = stats.lockstep_cycles + stats.per_lane_cycles;
+        std::fprintf(stderr, "Lockstep: %zu groups, %.1f%% of cycles in lockstep, %llu divergences\n", groups.size(),
+                     total_cycles ? 100.0 * stats.lockstep_cycles / total_cycles : 0.0,
+                     static_cast<unsigned long long>(stats.divergences.load()));
+        if (!Lockstep<8>::supported())
+            std::fprintf(stderr, "Lockstep: no std::experimental::simd on this compiler, lanes ran one at a time\n");
+    }
+
+    return all_ok ? 0 : 1;
+}
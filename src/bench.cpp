@@ -0,0 +1,333 @@
+/*
+    chip8-bench: emulator throughput per engine.
+
+    Usage: chip8-bench [--engine=interpreter|cached|jit|aot] [--cycles=N] [--repeat=N] [--json=file]
+
+    Three suites:
+        opcode  Small generated loops that exercise one group of opcodes
+                each (register ops, control flow, Dxyn, Fx33/Fx55/Fx65),
+                run with a huge frame budget so they time dispatch alone
+        rom     Every .ch8 in roms/test and roms/games/glitchGhost.ch8 at
+                the usual instructions per frame, frame overhead included
+        render  Expanding a frame to RGBA, and uploading and presenting it
+                through SDL (skipped if no video device is available, or
+                in builds without SDL2)
+
+    Every run gets the same instruction budget and the best of --repeat
+    runs is reported, as instructions/sec, ns/instruction and frames/sec.
+    Idle waits are skipped rather than run (see Emulator), so rates count
+    only the instructions actually run; the skipped ones are reported
+    alongside, and frames skipped whole don't count towards frames/sec.
+    --json writes the same results in machine-readable form for tracking
+    between releases.
+*/
+
+#include "emulator.h"
+#include "framebuffer.h"
+#include "headless_backend.h"
+#include "utilities.h"
+
+#if defined(CHIP8_SDL)
+    #include <SDL2/SDL.h>
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+    std::string suite;
+    std::string name;
+    std::string engine;     // Empty for render timings
+    uint64_t instructions = 0;     // Run, not counting idle cycles skipped
+    uint64_t idle_instructions = 0;
+    uint64_t frames = 0;            // Run, likewise
+    double seconds = 0.0;
+};
+
+// Opcode group loops. Each runs from 0x200 and jumps back to its start,
+//  so the loop never looks idle to the CPU.
+struct OpcodeBench {
+    const char* name;
+    std::vector<uint16_t> program;
+};
+
+static const std::vector<OpcodeBench> OPCODE_BENCHES = {
+    {"register", {
+        0x6012, 0x6134, 0x7001, 0x8010, 0x8011, 0x8012, 0x8013, 0x8014,
+        0x8015, 0x8016, 0x8017, 0x801E, 0x7105, 0x8104, 0x6A00, 0x1200,
+    }},
+    {"control", {
+        0x6000,             // 0x200: V0 = 0
+        0x3001,             // 0x202: no skip
+        0x4001,             // 0x204: skips 0x206
+        0x6001,
+        0x5010,             // 0x208: V0 == V1, skips 0x20A
+        0x6001,
+        0x9010,             // 0x20C: no skip
+        0x2214,             // 0x20E: call 0x214
+        0xB216,             // 0x210: jump to 0x216 + V0
+        0x0000,
+        0x00EE,             // 0x214: return
+        0x1202,             // 0x216: back to the top
+    }},
+    {"draw", {
+        0x6000, 0x6100, 0xA050,
+        0xD015, 0x7008, 0x7103, 0xD015, 0x7008, 0x7103,
+        0xD01F, 0x7008, 0x7103, 0xD01F, 0x1206,
+    }},
+    {"memory", {
+        0xA300, 0x6A7B, 0xFA33, 0xFF55, 0xA300, 0xFF65,
+        0xA310, 0xF733, 0xF755, 0xA310, 0xF765, 0x1200,
+    }},
+};
+
+static const char* engine_name(CPU::Engine engine) {
+    switch (engine) {
+        case CPU::Engine::Interpreter: return "interpreter";
+        case CPU::Engine::Cached:      return "cached";
+        case CPU::Engine::Jit:         return "jit";
+        case CPU::Engine::Aot:         return "aot";
+    }
+    return "";
+}
+
+// One fresh emulator per run, timed from the first instruction; the best
+//  of `repeat` runs counts
+static BenchResult run_rom(const std::string& rom_path, CPU::Engine engine, uint32_t cycles_per_frame,
+                           uint64_t cycles, uint32_t repeat) {
+    BenchResult best;
+    best.engine = engine_name(engine);
+    for (uint32_t run = 0; run < repeat; run++) {
+        Emulator emulator(std::make_unique<HeadlessBackend>());
+        emulator.set_cpu_engine(engine);
+        emulator.set_cycles_per_frame(cycles_per_frame);
+        emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+        emulator.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
+        emulator.load_rom(rom_path);
+
+        auto start = std::chrono::steady_clock::now();
+        emulator.run(0, cycles);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        if (run == 0 || seconds < best.seconds) {
+            best.instructions = emulator.cycles() - emulator.idle_cycles();
+            best.idle_instructions = emulator.idle_cycles();
+            best.frames = emulator.frame() - emulator.skipped_frames();
+            best.seconds = seconds;
+        }
+    }
+    return best;
+}
+
+static std::string write_program(const OpcodeBench& bench) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / (std::string("chip8-bench-") + bench.name + ".ch8");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    for (uint16_t opcode : bench.program) {
+        out.put(static_cast<char>(opcode >> 8));
+        out.put(static_cast<char>(opcode & 0xFF));
+    }
+    if (!out)
+        throw std::runtime_error("Failed to write " + path.string());
+    return path.string();
+}
+
+/*
+    Render timings
+*/
+template <typename Fn>
+static BenchResult time_frames(const char* name, uint64_t frames, Fn&& render) {
+    BenchResult result;
+    result.suite = "render";
+    result.name = name;
+    result.frames = frames;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        render(frame);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+static Framebuffer test_pattern(bool hires) {
+    // Something in every plane, so the expansion can't take shortcuts
+    Framebuffer pixels;
+    pixels.set_hires(hires);
+    for (size_t plane = 0; plane < Framebuffer::PLANES; plane++) {
+        for (uint16_t y = 0; y < pixels.height(); y++) {
+            pixels.row(plane, y) = {(0x0123456789ABCDEFull * (plane + 1)) ^ y, (0xFEDCBA9876543210ull >> plane) ^ y};
+        }
+    }
+    return pixels;
+}
+
+static void run_render(uint64_t frames, std::vector<BenchResult>& results) {
+    Framebuffer lores = test_pattern(false);
+    Framebuffer hires = test_pattern(true);
+    std::vector<uint32_t> rgba(Utils::HIRES_WIDTH * Utils::HIRES_HEIGHT);
+    const int pitch = Utils::HIRES_WIDTH * sizeof(uint32_t);
+
+    results.push_back(time_frames("expand_lores", frames, [&](uint64_t) { lores.to_rgba(rgba.data(), pitch); }));
+    results.push_back(time_frames("expand_hires", frames, [&](uint64_t) { hires.to_rgba(rgba.data(), pitch); }));
+
+#if defined(CHIP8_SDL)
+    // The same path SdlBackend::draw takes, in a hidden window
+    if (SDL_Init(SDL_INIT_VIDEO) < 0) {
+        std::fprintf(stderr, "No video device, skipping texture timings: %s\n", SDL_GetError());
+        return;
+    }
+    SDL_Window* window = SDL_CreateWindow(Utils::WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+        Utils::WINDOW_WIDTH, Utils::WINDOW_HEIGHT, SDL_WINDOW_HIDDEN);
+    SDL_Renderer* renderer = window ? SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED) : nullptr;
+    SDL_Texture* texture = renderer ? SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+        Utils::HIRES_WIDTH, Utils::HIRES_HEIGHT) : nullptr;
+
+    if (texture) {
+        auto upload = [&](uint64_t frame) {
+            void* texture_pixels = nullptr;
+            int texture_pitch = 0;
+            if (SDL_LockTexture(texture, nullptr, &texture_pixels, &texture_pitch) == 0) {
+                ((frame & 1) ? hires : lores).to_rgba(texture_pixels, texture_pitch);
+                SDL_UnlockTexture(texture);
+            }
+        };
+        results.push_back(time_frames("texture_upload", frames, upload));
+        results.push_back(time_frames("texture_present", frames, [&](uint64_t frame) {
+            upload(frame);
+            SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+            SDL_RenderPresent(renderer);
+        }));
+    } else {
+        std::fprintf(stderr, "Failed to set up a renderer, skipping texture timings: %s\n", SDL_GetError());
+    }
+
+    if (texture)
+        SDL_DestroyTexture(texture);
+    if (renderer)
+        SDL_DestroyRenderer(renderer);
+    if (window)
+        SDL_DestroyWindow(window);
+    SDL_Quit();
+#else
+    std::fprintf(stderr, "Built without SDL2, skipping texture timings\n");
+#endif
+}
+
+/*
+    Reporting
+*/
+static void print_results(const std::vector<BenchResult>& results) {
+    std::printf("%-8s %-14s %-12s %10s %10s %12s %8s\n", "suite", "name", "engine", "MIPS", "ns/instr", "frames/sec", "idle");
+    for (const BenchResult& result : results) {
+        double fps = result.seconds > 0 ? result.frames / result.seconds : 0.0;
+        if (result.instructions == 0) {
+            std::printf("%-8s %-14s %-12s %10s %10s %12.0f %8s\n", result.suite.c_str(), result.name.c_str(), "-", "-", "-", fps, "-");
+            continue;
+        }
+        double idle = 100.0 * result.idle_instructions / (result.instructions + result.idle_instructions);
+        std::printf("%-8s %-14s %-12s %10.2f %10.3f %12.0f %7.1f%%\n", result.suite.c_str(), result.name.c_str(), result.engine.c_str(),
+            result.instructions / result.seconds / 1e6, result.seconds * 1e9 / result.instructions, fps, idle);
+    }
+}
+
+static void write_json(const std::string& path, const std::vector<BenchResult>& results, uint64_t cycles, uint32_t repeat) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open " + path);
+
+    // Names are all plain identifiers and paths, so nothing needs escaping
+    out << "{\n  \"cycles\": " << cycles << ",\n  \"repeat\": " << repeat << ",\n  \"results\": [";
+    for (size_t idx = 0; idx < results.size(); idx++) {
+        const BenchResult& result = results[idx];
+        double seconds = result.seconds > 0 ? result.seconds : 1e-12;
+        out << (idx ? ",\n" : "\n") << "    {\"suite\": \"" << result.suite << "\", \"name\": \"" << result.name << "\"";
+        if (!result.engine.empty())
+            out << ", \"engine\": \"" << result.engine << "\"";
+        out << ", \"instructions\": " << result.instructions << ", \"idle_instructions\": " << result.idle_instructions
+            << ", \"frames\": " << result.frames
+            << ", \"seconds\": " << result.seconds
+            << ", \"instructions_per_second\": " << result.instructions / seconds
+            << ", \"ns_per_instruction\": " << (result.instructions ? result.seconds * 1e9 / result.instructions : 0.0)
+            << ", \"frames_per_second\": " << result.frames / seconds << "}";
+    }
+    out << "\n  ]\n}\n";
+    if (!out)
+        throw std::runtime_error("Failed to write " + path);
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<CPU::Engine> engines = {CPU::Engine::Interpreter, CPU::Engine::Cached, CPU::Engine::Jit, CPU::Engine::Aot};
+    uint64_t cycles = 20'000'000;
+    uint32_t repeat = 3;
+    std::string json_path;
+    for (int arg_idx = 1; arg_idx < argc; arg_idx++) {
+        std::string arg(argv[arg_idx]);
+
+        if (arg == "--engine=interpreter") {
+            engines = {CPU::Engine::Interpreter};
+        } else if (arg == "--engine=cached") {
+            engines = {CPU::Engine::Cached};
+        } else if (arg == "--engine=jit") {
+            engines = {CPU::Engine::Jit};
+        } else if (arg == "--engine=aot") {
+            engines = {CPU::Engine::Aot};
+        } else if (arg.starts_with("--cycles=")) {
+            cycles = std::max<uint64_t>(1, std::stoull(arg.substr(std::string("--cycles=").size())));
+        } else if (arg.starts_with("--repeat=")) {
+            repeat = std::max<uint32_t>(1, std::stoul(arg.substr(std::string("--repeat=").size())));
+        } else if (arg.starts_with("--json=")) {
+            json_path = arg.substr(std::string("--json=").size());
+        } else {
+            std::fprintf(stderr, "Usage: chip8-bench [--engine=interpreter|cached|jit|aot] [--cycles=N] [--repeat=N] [--json=file]\n");
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    try {
+        // Opcode groups: one frame per million instructions keeps frame
+        //  work out of the numbers
+        for (const OpcodeBench& bench : OPCODE_BENCHES) {
+            std::string path = write_program(bench);
+            for (CPU::Engine engine : engines) {
+                BenchResult result = run_rom(path, engine, 1'000'000, cycles, repeat);
+                result.suite = "opcode";
+                result.name = bench.name;
+                results.push_back(result);
+            }
+            std::filesystem::remove(path);
+        }
+
+        // Whole ROMs at the usual pace
+        std::vector<std::string> roms;
+        for (const auto& entry : std::filesystem::directory_iterator("roms/test")) {
+            if (entry.path().extension() == ".ch8")
+                roms.push_back(entry.path().string());
+        }
+        std::sort(roms.begin(), roms.end());
+        roms.push_back("roms/games/glitchGhost.ch8");
+        for (const std::string& rom : roms) {
+            for (CPU::Engine engine : engines) {
+                BenchResult result = run_rom(rom, engine, Utils::CYCLES_PER_FRAME, cycles, repeat);
+                result.suite = "rom";
+                result.name = std::filesystem::path(rom).stem().string();
+                results.push_back(result);
+            }
+        }
+
+        run_render(std::max<uint64_t>(1, cycles / 10'000), results);
+
+        print_results(results);
+        if (!json_path.empty())
+            write_json(json_path, results, cycles, repeat);
+    } catch (const std::exception& error) {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
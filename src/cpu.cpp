@@ -1,9 +1,14 @@
 #include "cpu.h"
+#include "guest_profiler.h"
 #include "utilities.h"
 #include "print.h"
 
+#include <algorithm>
+#include <bit>
 #include <string>
 #include <random>
+#include <span>
+#include <utility>
 
 
 CPU::CPU(Peripherals& peripherals, RAM& ram, Timer& delay_timer, Timer& sound_timer )
@@ -12,28 +17,692 @@ CPU::CPU(Peripherals& peripherals, RAM& ram, Timer& delay_timer, Timer& sound_ti
       delay_timer_(delay_timer),
       sound_timer_(sound_timer)
 {
+    ram_.set_size(profile_memory_size(profile_));
     rand_.seed();
 }
 
+CPU::~CPU() = default;
+
+consteval CPU::DispatchTable CPU::build_dispatch_table() {
+    DispatchTable table{};
+
+    // Resolve every (top nibble, low byte) pair against the opcode list once,
+    //  so cycle() never has to search it
+    for (uint16_t nibble = 0; nibble < table.size(); nibble++) {
+        for (uint16_t sub_op = 0; sub_op < table[nibble].size(); sub_op++) {
+            uint16_t opcode = nibble << 12 | sub_op;
+            table[nibble][sub_op] = INVALID_OPCODE;
+
+            for (uint8_t index = 0; index < opcode_handlers_.size(); index++) {
+                if ((opcode & opcode_handlers_[index].mask) == opcode_handlers_[index].pattern) {
+                    table[nibble][sub_op] = index;
+                    break;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+constinit const CPU::DispatchTable CPU::dispatch_table_ = CPU::build_dispatch_table();
+
+constexpr bool CPU::writes_memory(uint8_t index) {
+    return opcode_handlers_[index].pattern == 0xf033 ||
+           opcode_handlers_[index].pattern == 0xf055 ||
+           opcode_handlers_[index].pattern == 0x5002;
+}
+
+constexpr bool CPU::draws(uint8_t index) {
+    return opcode_handlers_[index].pattern == 0xd000;
+}
+
+// ===== Quirk profiles =====
+void CPU::set_profile(Profile profile) {
+    if (profile == profile_)
+        return;
+    profile_ = profile;
+
+    // Decoded blocks and generated code were built for the old quirks.
+    //  The AOT program's code is still watched, so pending writes to it are
+    //  taken before the marks go and its ranges are marked again after.
+    if (aot_program_)
+        check_aot_code_writes();
+    ram_.set_size(profile_memory_size(profile));
+    block_cache_.clear();
+    longest_block_ = 0;
+    ram_.clear_code_marks();
+    mark_aot_code();
+    jit_.reset();
+    frame_wait_ = false;
+}
+
+// ===== Save states =====
+void CPU::save(State& state) const {
+    std::copy_n(v_, state.v.size(), state.v.begin());
+    state.i = i_;
+    state.pc = pc_;
+    state.sp = sp_;
+    state.stack = stack_;
+    state.flags = flags_;
+    state.rand = rand_;
+    state.waiting_for_key = waiting_for_key_;
+    state.frame_wait = frame_wait_;
+    state.exited = exited_;
+    state.draw_flag = draw_flag;
+}
+
+void CPU::load(const State& state) {
+    if (state.sp > stack_.size())
+        throw std::runtime_error("Save state has a corrupt stack pointer");
+
+    // Decoded blocks stay cached: restoring RAM flags whatever code changed
+    std::copy_n(state.v.begin(), state.v.size(), v_);
+    i_ = state.i;
+    pc_ = state.pc;
+    sp_ = state.sp;
+    stack_ = state.stack;
+    flags_ = state.flags;
+    rand_ = state.rand;
+    waiting_for_key_ = state.waiting_for_key;
+    frame_wait_ = state.frame_wait;
+    exited_ = state.exited;
+    draw_flag = state.draw_flag;
+}
+
+template <typename Fn>
+void CPU::with_profile(Fn&& fn) {
+    switch (profile_) {
+        #define PROFILE_CASE(name) \
+            case Profile::name: fn.template operator()<profile_quirks(Profile::name)>(); break;
+        FOR_EACH_PROFILE(PROFILE_CASE)
+        #undef PROFILE_CASE
+    }
+}
+
+void CPU::cycle() {
+    with_profile([this]<Quirks Q>() { cycle<Q>(); });
+}
+
+void CPU::execute(Opcode opcode) {
+    with_profile([this, opcode]<Quirks Q>() { execute<Q>(opcode); });
+}
+
+void CPU::run(uint32_t cycles) {
+    // A Dxyn display wait holds the program until the next frame
+    if (frame_wait_)
+        return;
+
+    // Profiles show busy-wait loops where the program really spends them
+    if (!profiler_)
+        cycles -= skip_idle(cycles);
+    if (cycles == 0)
+        return;
+
+    with_profile([this, cycles]<Quirks Q>() { run_engine<Q>(cycles); });
+}
+
+template <Quirks Q>
 void CPU::cycle() {
-    uint16_t opcode = fetch_instruction();
-    parse_args(opcode);
-
-    //PRINT_DEBUG("PC: %04x, Opcode: %04x\n", pc_, opcode);
-
-    // Linear search through opcode_handlers_
-    //  (pre-sorted for most common first)
-    for (const auto& info : opcode_handlers_) {
-        if ((opcode & info.mask) == info.pattern) {
-            (this->*info.handler)();
-            if (info.auto_increment_pc) {
-                pc_ += 2;
+    Opcode opcode{fetch_instruction()};
+
+    //PRINT_DEBUG("PC: %04x, Opcode: %04x\n", pc_, opcode.raw);
+
+    execute<Q>(opcode);
+}
+
+template <Quirks Q>
+void CPU::run_engine(uint32_t cycles) {
+    if (profiler_) {
+        run_interpreter<Q, true>(cycles);
+        return;
+    }
+
+    switch (engine_) {
+        case Engine::Cached:
+            run_cached<Q>(cycles);
+            break;
+        case Engine::Jit:
+            run_jit<Q>(cycles);
+            break;
+        case Engine::Aot:
+            run_aot<Q>(cycles);
+            break;
+        case Engine::Interpreter:
+        default:
+            run_interpreter<Q>(cycles);
+            break;
+    }
+}
+
+// ===== Idle loops =====
+CPU::Idle CPU::idle() const {
+    Opcode opcode{peek_instruction(pc_)};
+
+    if (((opcode.raw & 0xF000) == 0x1000 && opcode.nnn() == pc_) || opcode.raw == 0x00FD)
+        return Idle::Halted;
+    if ((opcode.raw & 0xF0FF) == 0xF00A && waiting_for_key_ && !peripherals_.input_flag)
+        return Idle::Key;
+
+    uint16_t start;
+    if (delay_loop_start(start) && delay_timer_.get() != 0)
+        return Idle::DelayTimer;
+    return Idle::None;
+}
+
+uint16_t CPU::peek_instruction(int address) const {
+    if (address < 0 || static_cast<uint32_t>(address) + 1 >= ram_.size())
+        return 0;
+    return ram_.read(address) << 8 | ram_.read(address + 1);
+}
+
+bool CPU::delay_loop_start(uint16_t& start) const {
+    // pc_ can be on any of the loop's three instructions
+    for (int offset = 0; offset <= 4; offset += 2) {
+        int loop = pc_ - offset;
+        Opcode read{peek_instruction(loop)};
+        Opcode test{peek_instruction(loop + 2)};
+        Opcode jump{peek_instruction(loop + 4)};
+
+        if ((read.raw & 0xF0FF) == 0xF007 && (test.raw & 0xF0FF) == 0x3000 && test.x() == read.x() &&
+            (jump.raw & 0xF000) == 0x1000 && jump.nnn() == loop) {
+            start = loop;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t CPU::skip_idle(uint32_t cycles) {
+    // Quick reject: every idle loop has a 1nnn, 3xnn or Fx0A/Fx07 at pc_
+    uint16_t opcode = peek_instruction(pc_);
+    uint8_t group = opcode >> 12;
+    if (group != 0x1 && group != 0x3 && (opcode & 0xF0F0) != 0xF000)
+        return 0;
+
+    // Run up to two instructions normally to get to a settled state: the
+    //  top of a delay loop, or an Fx0A that has started waiting
+    uint32_t used = 0;
+    uint16_t start;
+    while (used < cycles && used < 2) {
+        bool mid_loop = delay_loop_start(start) && pc_ != start;
+        bool key_starting = (peek_instruction(pc_) & 0xF0FF) == 0xF00A && !waiting_for_key_;
+        if (!mid_loop && !key_starting)
+            break;
+        cycle();
+        used++;
+    }
+
+    uint32_t skipped = 0;
+    switch (idle()) {
+        case Idle::Halted:
+        case Idle::Key:
+            // Nothing changes until input arrives between runs (or ever)
+            skipped = cycles - used;
+            break;
+        case Idle::DelayTimer:
+            // The timer only ticks between runs, so every pass through the
+            //  loop lands back at the top with VX = DT
+            if (delay_loop_start(start) && pc_ == start) {
+                skipped = (cycles - used) / 3 * 3;
+                if (skipped > 0)
+                    v_[Opcode{peek_instruction(pc_)}.x()] = delay_timer_.get();
             }
-            return;
+            break;
+        default:
+            break;
+    }
+
+    idle_cycles_ += skipped;
+    return used + skipped;
+}
+
+// Expands M(index) for every entry in opcode_handlers_, used to stamp out
+//  one direct-call dispatch site per handler
+#define FOR_EACH_OPCODE_INDEX(M)                                    \
+    M(0)  M(1)  M(2)  M(3)  M(4)  M(5)  M(6)  M(7)  M(8)  M(9)      \
+    M(10) M(11) M(12) M(13) M(14) M(15) M(16) M(17) M(18) M(19)     \
+    M(20) M(21) M(22) M(23) M(24) M(25) M(26) M(27) M(28) M(29)     \
+    M(30) M(31) M(32) M(33) M(34) M(35) M(36) M(37) M(38) M(39)     \
+    M(40) M(41) M(42) M(43) M(44) M(45) M(46) M(47) M(48) M(49)
+
+#define OPCODE_LABEL(index) &&op_##index,
+
+// Same again for fused_forms_
+#define FOR_EACH_FUSED_FORM(M) M(0) M(1) M(2) M(3)
+
+#define FUSED_LABEL(form) &&fused_##form,
+
+template <Quirks Q, bool Profiled>
+void CPU::run_interpreter(uint32_t cycles) {
+    if (cycles == 0)
+        return;
+
+#if defined(__GNUC__)
+    // Threaded dispatch: every handler gets its own copy of the fetch/decode
+    //  jump, which keeps the host branch predictor from funnelling all
+    //  opcodes through one indirect branch. Under display_wait, Dxyn also
+    //  ends the run once it starts waiting for the frame.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static_assert(opcode_handlers_.size() == 50, "Update FOR_EACH_OPCODE_INDEX");
+    static const void* const labels[] = { FOR_EACH_OPCODE_INDEX(OPCODE_LABEL) &&op_invalid };
+
+    Opcode opcode{fetch_instruction()};
+    goto *labels[decode(opcode)];
+
+    #define THREADED_OP(index)                                  \
+        op_##index:                                             \
+            if constexpr (Profiled)                             \
+                profile_instruction<Q>(index, opcode);          \
+            execute_as<Q, index>(opcode);                       \
+            if (--cycles == 0) return;                          \
+            if constexpr (Q.display_wait && draws(index)) {     \
+                if (frame_wait_) return;                        \
+            }                                                   \
+            opcode = Opcode{fetch_instruction()};               \
+            goto *labels[decode(opcode)];
+
+    FOR_EACH_OPCODE_INDEX(THREADED_OP)
+    #undef THREADED_OP
+
+    op_invalid:
+        PRINT_ERROR("Invalid Opcode %04x", opcode.raw);
+#pragma GCC diagnostic pop
+#else
+    // Portable fallback: plain table dispatch per cycle
+    while (cycles-- && !frame_wait_) {
+        if constexpr (Profiled) {
+            Opcode opcode{fetch_instruction()};
+            profile_instruction<Q>(decode(opcode), opcode);
         }
+        cycle<Q>();
     }
+#endif
+}
 
-    PRINT_ERROR("Invalid Opcode %04x", opcode);
+template <Quirks Q>
+void CPU::profile_instruction(uint8_t index, Opcode opcode) {
+    if (index == INVALID_OPCODE)
+        return;
+    uint16_t pattern = opcode_handlers_[index].pattern;
+    profiler_->instruction(pc_, index, pattern == 0xf000 ? 4 : 2);
+
+    // Calls and returns, and memory the instruction reads or writes as data
+    uint8_t planes = static_cast<uint8_t>(std::popcount(peripherals_.plane_mask));
+    uint8_t span = static_cast<uint8_t>((opcode.x() > opcode.y() ? opcode.x() - opcode.y() : opcode.y() - opcode.x()) + 1);
+    switch (pattern) {
+        case 0x2000: profiler_->call(opcode.nnn()); break;
+        case 0x00ee: profiler_->ret(); break;
+        case 0xd000: {
+            uint32_t bytes = opcode.n();
+            if (Q.large_sprites && bytes == 0)
+                bytes = 32;
+            profiler_->data(i_, bytes * planes, false);
+            break;
+        }
+        case 0xf033: profiler_->data(i_, 3, true); break;
+        case 0xf055: profiler_->data(i_, opcode.x() + 1, true); break;
+        case 0xf065: profiler_->data(i_, opcode.x() + 1, false); break;
+        case 0x5002: profiler_->data(i_, span, true); break;
+        case 0x5003: profiler_->data(i_, span, false); break;
+        case 0xf002: profiler_->data(i_, Utils::AUDIO_PATTERN_BYTES, false); break;
+        default: break;
+    }
+}
+
+const char* CPU::opcode_name(uint8_t index) {
+    return index < opcode_handlers_.size() ? opcode_handlers_[index].name : "invalid";
+}
+
+uint8_t CPU::decode(Opcode opcode) {
+    uint8_t index = dispatch_table_[opcode.raw >> 12][opcode.nn()];
+
+    // The table only sees the top nibble and low byte, so confirm the full
+    //  pattern (this rejects e.g. 0x01E0, which is not a valid 00E0)
+    if (index == INVALID_OPCODE || (opcode.raw & opcode_handlers_[index].mask) != opcode_handlers_[index].pattern)
+        return INVALID_OPCODE;
+
+    return index;
+}
+
+template <Quirks Q>
+void CPU::execute(Opcode opcode) {
+    uint8_t index = decode(opcode);
+    if (index == INVALID_OPCODE)
+        PRINT_ERROR("Invalid Opcode %04x", opcode.raw);
+
+    const OpcodeInfo& info = opcode_table_<Q>[index];
+    (this->*info.handler)(opcode);
+    if (info.auto_increment_pc) {
+        pc_ += 2;
+    }
+}
+
+template <Quirks Q>
+void CPU::execute_index(uint8_t index, Opcode opcode) {
+    // Switch on a pre-decoded index; every case is a direct, inlinable call
+    switch (index) {
+        #define EXECUTE_CASE(index) case index: execute_as<Q, index>(opcode); break;
+        FOR_EACH_OPCODE_INDEX(EXECUTE_CASE)
+        #undef EXECUTE_CASE
+        default:
+            PRINT_ERROR("Invalid Opcode %04x", opcode.raw);
+    }
+}
+
+template <Quirks Q, uint8_t Index>
+void CPU::execute_as(Opcode opcode) {
+    // Index is known at compile time, so this is a direct (inlinable) call
+    constexpr OpcodeInfo info = opcode_table_<Q>[Index];
+    (this->*info.handler)(opcode);
+    if constexpr (info.auto_increment_pc) {
+        pc_ += 2;
+    }
+}
+
+// ===== Block cache =====
+template <Quirks Q>
+void CPU::run_cached(uint32_t cycles) {
+    if (cycles == 0)
+        return;
+
+#if defined(__GNUC__)
+    // Same threading as the interpreter, but walking pre-decoded micro-ops
+    //  and only returning to the block lookup at the end of each block
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static_assert(FUSED_FORM_COUNT == 4, "Update FOR_EACH_FUSED_FORM");
+    static const void* const labels[] = { FOR_EACH_OPCODE_INDEX(OPCODE_LABEL) nullptr,
+                                          FOR_EACH_FUSED_FORM(FUSED_LABEL) };
+
+    const MicroOp* op;
+    const MicroOp* block_end;
+
+    next_block:
+        if (ram_.code_dirty())
+            invalidate_blocks();
+        {
+            const DecodedBlock& block = lookup_block(pc_);
+            if (block.ops.empty()) {
+                // Nothing decodable here, let the interpreter report it
+                cycle<Q>();
+                if (--cycles == 0) return;
+                goto next_block;
+            }
+            op = block.fused_ops.data();
+            block_end = op + block.fused_ops.size();
+        }
+        goto *labels[op->index];
+
+    // Ops that write RAM may have rewritten this very block, so they
+    //  re-check the code map before carrying on
+    #define CACHED_OP(slot)                                     \
+        op_##slot:                                              \
+            execute_as<Q, slot>(op->opcode);                    \
+            if (--cycles == 0) return;                          \
+            if constexpr (Q.display_wait && draws(slot)) {      \
+                if (frame_wait_) return;                        \
+            }                                                   \
+            if (++op == block_end) goto next_block;             \
+            if constexpr (writes_memory(slot)) {                \
+                if (ram_.code_dirty()) goto next_block;         \
+            }                                                   \
+            goto *labels[op->index];
+
+    FOR_EACH_OPCODE_INDEX(CACHED_OP)
+    #undef CACHED_OP
+
+    // Fused ops retire several instructions at once; near the end of the
+    //  budget, step the remainder through the interpreter instead
+    #define FUSED_OP(form)                                                  \
+        fused_##form:                                                       \
+            if (cycles < fused_forms_[form].length) {                       \
+                for (; cycles > 0 && !frame_wait_; cycles--)                \
+                    cycle<Q>();                                             \
+                return;                                                     \
+            }                                                               \
+            fused_counts_[form]++;                                          \
+            cycles -= (this->*fused_table_<Q>[form].handler)(*op);          \
+            if (cycles == 0) return;                                        \
+            if constexpr (Q.display_wait) {                                 \
+                if (frame_wait_) return;                                    \
+            }                                                               \
+            if (++op == block_end) goto next_block;                         \
+            goto *labels[op->index];
+
+    FOR_EACH_FUSED_FORM(FUSED_OP)
+    #undef FUSED_OP
+#pragma GCC diagnostic pop
+#else
+    while (cycles > 0 && !frame_wait_) {
+        if (ram_.code_dirty())
+            invalidate_blocks();
+
+        cycles -= run_block<Q>(lookup_block(pc_), cycles);
+    }
+#endif
+}
+
+template <Quirks Q>
+uint32_t CPU::run_block(const DecodedBlock& block, uint32_t cycles) {
+    if (block.ops.empty()) {
+        // Nothing decodable here, let the interpreter report it
+        cycle<Q>();
+        return 1;
+    }
+
+    uint32_t executed = 0;
+    for (const MicroOp& op : block.ops) {
+        execute_index<Q>(op.index, op.opcode);
+
+        // Stop early on budget, if this op rewrote decoded code (the block
+        //  itself may now be stale), or if it started a display wait
+        if (++executed == cycles || (writes_memory(op.index) && ram_.code_dirty()) ||
+            (Q.display_wait && frame_wait_))
+            break;
+    }
+    return executed;
+}
+
+CPU::DecodedBlock& CPU::lookup_block(uint16_t address) {
+    // Past the profile's memory there is nothing to decode; the
+    //  interpreter runs it through the access policy instead
+    if (address >= ram_.size())
+        return unreachable_block_;
+    if (block_cache_.empty())
+        block_cache_.resize(ram_.size());
+
+    std::unique_ptr<DecodedBlock>& block = block_cache_[address];
+    if (!block) {
+        block = decode_block(address);
+        ram_.mark_code(block->start, block->end);
+        longest_block_ = std::max(longest_block_, block->end - block->start);
+    }
+    return *block;
+}
+
+std::unique_ptr<CPU::DecodedBlock> CPU::decode_block(uint16_t address) {
+    auto block = std::make_unique<DecodedBlock>();
+    block->start = address;
+    block->end = address;
+
+    while (block->end + 1 < ram_.size()) {
+        Opcode opcode{static_cast<uint16_t>(ram_.read(block->end) << 8 | ram_.read(block->end + 1))};
+        uint8_t index = decode(opcode);
+        if (index == INVALID_OPCODE)
+            break;
+
+        const OpcodeInfo& info = opcode_handlers_[index];
+        block->ops.push_back({opcode, info.auto_increment_pc, index});
+        block->end += 2;
+
+        if (info.ends_block)
+            break;
+    }
+
+    fuse_block(*block);
+    return block;
+}
+
+void CPU::fuse_block(DecodedBlock& block) {
+    // A skip that ends the block may guard a jump; pull that jump in as
+    //  a lookahead so loop forms can fuse across the skip
+    std::vector<MicroOp> ops = block.ops;
+    bool has_lookahead = false;
+    if (!ops.empty() && block.end + 1 < ram_.size()) {
+        const OpcodeInfo& last = opcode_handlers_[ops.back().index];
+        bool ends_in_skip = last.ends_block && last.auto_increment_pc && last.pattern != 0x00ee;
+
+        Opcode next{static_cast<uint16_t>(ram_.read(block.end) << 8 | ram_.read(block.end + 1))};
+        uint8_t index = decode(next);
+        if (ends_in_skip && index != INVALID_OPCODE && opcode_handlers_[index].pattern == 0x1000) {
+            ops.push_back({next, false, index});
+            has_lookahead = true;
+        }
+    }
+
+    block.fused_ops.clear();
+    size_t op_idx = 0;
+    while (op_idx < block.ops.size()) {
+        bool fused = false;
+        for (uint8_t form = 0; form < fused_forms_.size() && !fused; form++) {
+            const FusedInfo& info = fused_forms_[form];
+            if (op_idx + info.length > ops.size())
+                continue;
+
+            bool matches = true;
+            for (uint8_t part = 0; part < info.length; part++) {
+                matches &= (ops[op_idx + part].opcode.raw & info.masks[part]) == info.patterns[part];
+            }
+            if (!matches)
+                continue;
+
+            MicroOp fused_op = ops[op_idx];
+            fused_op.index = FUSED_INDEX_BASE + form;
+            for (uint8_t part = 1; part < info.length; part++) {
+                fused_op.fused[part - 1] = ops[op_idx + part].opcode;
+            }
+            block.fused_ops.push_back(fused_op);
+            op_idx += info.length;
+            fused = true;
+        }
+
+        if (!fused)
+            block.fused_ops.push_back(ops[op_idx++]);
+    }
+
+    // The lookahead jump is now part of this block's code
+    if (has_lookahead && op_idx > block.ops.size())
+        block.end += 2;
+}
+
+void CPU::invalidate_blocks() {
+    uint32_t dirty_start, dirty_end;
+    if (!ram_.take_code_writes(dirty_start, dirty_end))
+        return;
+
+    // Only blocks starting less than the longest block's length before the
+    //  write can overlap it, so scan just that window rather than all of
+    //  memory. Drop every block overlapping the written range.
+    uint32_t cleared_start = dirty_start;
+    uint32_t cleared_end = dirty_end;
+    uint32_t scan_end = std::min<uint32_t>(dirty_end, block_cache_.size());
+    for (uint32_t address = dirty_start - std::min(dirty_start, longest_block_); address < scan_end; address++) {
+        std::unique_ptr<DecodedBlock>& block = block_cache_[address];
+        if (block && dirty_start < block->end) {
+            cleared_start = std::min<uint32_t>(cleared_start, block->start);
+            cleared_end = std::max(cleared_end, block->end);
+            block.reset();
+        }
+    }
+
+    // Rebuild the code map over the dropped range from the survivors that
+    //  overlap it (blocks may overlap each other)
+    ram_.clear_code_marks(cleared_start, cleared_end);
+    scan_end = std::min<uint32_t>(cleared_end, block_cache_.size());
+    for (uint32_t address = cleared_start - std::min(cleared_start, longest_block_); address < scan_end; address++) {
+        const std::unique_ptr<DecodedBlock>& block = block_cache_[address];
+        if (block && cleared_start < block->end)
+            ram_.mark_code(block->start, block->end);
+    }
+}
+
+// ===== JIT =====
+template <Quirks Q, uint8_t Index>
+bool CPU::jit_callback(CPU* cpu, uint16_t opcode) {
+    // Exceptions can't unwind through generated code, so park them and
+    //  leave the block; run_jit rethrows once back in C++
+    try {
+        cpu->execute_as<Q, Index>(Opcode{opcode});
+    } catch (...) {
+        cpu->jit_exception_ = std::current_exception();
+        return true;
+    }
+    if constexpr (Q.display_wait && draws(Index)) {
+        if (cpu->frame_wait_)
+            return true;
+    }
+    return cpu->ram_.code_dirty();
+}
+
+template <Quirks Q>
+void CPU::run_jit(uint32_t cycles) {
+    if (!jit_) {
+        // Generated code addresses I and PC relative to V0. set_profile()
+        //  drops the JIT, so it always matches the running quirks.
+        auto base = reinterpret_cast<intptr_t>(v_);
+        jit_ = std::make_unique<JIT>(reinterpret_cast<intptr_t>(&i_) - base,
+                                     reinterpret_cast<intptr_t>(&pc_) - base, Q);
+    }
+
+    if (!jit_->ready()) {
+        // No executable memory on this host
+        run_cached<Q>(cycles);
+        return;
+    }
+
+    while (cycles > 0 && !frame_wait_) {
+        if (ram_.code_dirty())
+            invalidate_blocks();
+
+        DecodedBlock& block = lookup_block(pc_);
+        if (!block.native && !block.ops.empty() && ++block.hits >= JIT_HOT_THRESHOLD)
+            compile_block<Q>(block);
+
+        // Compiled blocks always run to completion, so only use them when
+        //  the whole block fits in the remaining budget
+        if (block.native && block.ops.size() <= cycles) {
+            cycles -= block.native(this, v_);
+            if (jit_exception_)
+                std::rethrow_exception(std::exchange(jit_exception_, nullptr));
+        } else {
+            cycles -= run_block<Q>(block, cycles);
+        }
+    }
+}
+
+template <Quirks Q>
+void CPU::compile_block(DecodedBlock& block) {
+    static constexpr auto callbacks = []<size_t... Indices>(std::index_sequence<Indices...>) {
+        return std::array<JIT::Callback, sizeof...(Indices)>{&CPU::jit_callback<Q, Indices>...};
+    }(std::make_index_sequence<opcode_handlers_.size()>{});
+
+    std::vector<JIT::Instruction> instructions;
+    instructions.reserve(block.ops.size());
+    for (const MicroOp& op : block.ops) {
+        instructions.push_back({op.opcode.raw, callbacks[op.index]});
+    }
+
+    block.native = jit_->compile(block.start, instructions);
+    if (!block.native) {
+        // Code buffer is full: drop every compiled block and start over
+        for (auto& cached : block_cache_) {
+            if (cached)
+                cached->native = nullptr;
+        }
+        jit_->flush();
+        block.native = jit_->compile(block.start, instructions);
+    }
 }
 
 void CPU::push_stack(uint16_t address) {
@@ -54,54 +723,179 @@ uint16_t CPU::fetch_instruction() {
     return ram_.read(pc_) << 8 | ram_.read(pc_ + 1);
 }
 
-void CPU::parse_args(uint16_t opcode) {
-    x_ = (opcode & 0x0F00) >> 8;
-    y_ = (opcode & 0x00F0) >> 4;
-    n_ = opcode & 0x000F;
-    nn_ = opcode & 0x00FF;
-    nnn_ = opcode & 0x0FFF;
+// ===== AOT =====
+std::vector<const CPU::AotProgram*>& CPU::aot_registry() {
+    // Function-local so generated programs can register during static init
+    static std::vector<const AotProgram*> registry;
+    return registry;
+}
+
+bool CPU::register_aot_program(const AotProgram* program) {
+    aot_registry().push_back(program);
+    return true;
+}
+
+bool CPU::load_aot_program(uint16_t address, uint16_t size) {
+    std::vector<uint8_t> rom(size);
+    for (uint16_t offset = 0; offset < size; offset++) {
+        rom[offset] = ram_.read(address + offset);
+    }
+    uint32_t rom_hash = Utils::fnv1a(rom.data(), rom.size());
+
+    aot_program_ = nullptr;
+    for (const AotProgram* program : aot_registry()) {
+        if (program->rom_hash == rom_hash && program->rom_size == size) {
+            aot_program_ = program;
+            break;
+        }
+    }
+    if (!aot_program_)
+        return false;
+
+    PRINT_DEBUG("Using AOT program %s", aot_program_->name);
+
+    mark_aot_code();
+    aot_code_modified_ = false;
+    return true;
+}
+
+void CPU::mark_aot_code() {
+    if (!aot_program_)
+        return;
+
+    // Watch the translated code so self-modifying writes are noticed
+    for (size_t range_idx = 0; range_idx < aot_program_->code_range_count; range_idx++) {
+        const AotCodeRange& range = aot_program_->code_ranges[range_idx];
+        ram_.mark_code(range.start, range.end);
+    }
+}
+
+bool CPU::check_aot_code_writes() {
+    uint32_t dirty_start, dirty_end;
+    if (!ram_.take_code_writes(dirty_start, dirty_end))
+        return false;
+
+    // From here on, generated blocks verify their bytes before running
+    aot_code_modified_ = true;
+    return true;
+}
+
+bool CPU::AotContext::code_intact(uint16_t address, const uint8_t* bytes, uint16_t length) const {
+    for (uint16_t offset = 0; offset < length; offset++) {
+        if (cpu.ram_.read(address + offset) != bytes[offset])
+            return false;
+    }
+    return true;
+}
+
+template <Quirks Q>
+void CPU::run_aot(uint32_t cycles) {
+    // Translated programs have no way to stop for a display wait, and
+    //  their skips always step over two bytes
+    if (!aot_program_ || Q.display_wait || Q.long_skip) {
+        run_cached<Q>(cycles);
+        return;
+    }
+
+    AotContext ctx{v_, i_, pc_, peripherals_, delay_timer_, sound_timer_, *this};
+    while (cycles > 0) {
+        check_aot_code_writes();
+
+        // The program returns 0 when PC isn't at a translated block it can
+        //  run in full (computed jumps, rewritten code, small budgets)
+        uint32_t executed = aot_program_->run(ctx, cycles);
+        if (executed == 0) {
+            cycle<Q>();
+            executed = 1;
+        }
+        cycles -= executed;
+    }
+}
+
+// ===== Superinstructions =====
+template <Quirks Q>
+uint8_t CPU::fused_annn_dxyn(const MicroOp& op) {
+    op_annn(op.opcode);
+    op_dxyn<Q>(op.fused[0]);
+    pc_ += 4;
+    return 2;
+}
+
+uint8_t CPU::fused_6xnn_6xnn(const MicroOp& op) {
+    op_6xnn(op.opcode);
+    op_6xnn(op.fused[0]);
+    pc_ += 4;
+    return 2;
+}
+
+uint8_t CPU::fused_7xnn_3xnn_1nnn(const MicroOp& op) {
+    op_7xnn(op.opcode);
+    if (v_[op.fused[0].x()] == op.fused[0].nn()) {
+        // Skip taken, the jump never runs
+        pc_ += 6;
+        return 2;
+    }
+    pc_ = op.fused[1].nnn();
+    return 3;
+}
+
+uint8_t CPU::fused_fx07_3x00_1nnn(const MicroOp& op) {
+    op_fx07(op.opcode);
+    if (v_[op.fused[0].x()] == 0) {
+        // Skip taken, the jump never runs
+        pc_ += 6;
+        return 2;
+    }
+    pc_ = op.fused[1].nnn();
+    return 3;
 }
 
 // ===== Register operations (most common) =====
-void CPU::op_6xnn() {
+void CPU::op_6xnn(Opcode op) {
     // Set vx to nn
-    v_[x_] = nn_;
+    v_[op.x()] = op.nn();
 }
 
-void CPU::op_7xnn() {
+void CPU::op_7xnn(Opcode op) {
     // Set vx to vx += nn
-    v_[x_] += nn_;
+    v_[op.x()] += op.nn();
 }
 
-void CPU::op_8xy0() {
+void CPU::op_8xy0(Opcode op) {
     // Set vx to vy
-    v_[x_] = v_[y_];
+    v_[op.x()] = v_[op.y()];
 }
 
-void CPU::op_8xy1() {
-    // Set vx to vx|=vy and clear vf
-    v_[x_] |= v_[y_];
-    v_[0xF] = 0;
+template <Quirks Q>
+void CPU::op_8xy1(Opcode op) {
+    // Set vx to vx|=vy, the VIP also clears vf
+    v_[op.x()] |= v_[op.y()];
+    if constexpr (Q.vf_reset)
+        v_[0xF] = 0;
 }
 
-void CPU::op_8xy2() {
-    // Set vx to vx&=vy and clear vf
-    v_[x_] &= v_[y_];
-    v_[0xF] = 0;
+template <Quirks Q>
+void CPU::op_8xy2(Opcode op) {
+    // Set vx to vx&=vy, the VIP also clears vf
+    v_[op.x()] &= v_[op.y()];
+    if constexpr (Q.vf_reset)
+        v_[0xF] = 0;
 }
 
-void CPU::op_8xy3() {
-    // Set vx to vx^=vy and clear vf
-    v_[x_] ^= v_[y_];
-    v_[0xF] = 0;
+template <Quirks Q>
+void CPU::op_8xy3(Opcode op) {
+    // Set vx to vx^=vy, the VIP also clears vf
+    v_[op.x()] ^= v_[op.y()];
+    if constexpr (Q.vf_reset)
+        v_[0xF] = 0;
 }
 
-void CPU::op_8xy4() {
+void CPU::op_8xy4(Opcode op) {
     // Set vx to vx += vy
     // Calculate overflow up front so VF can be an input
-    bool overflow = v_[x_] > UINT8_MAX - v_[y_];
+    bool overflow = v_[op.x()] > UINT8_MAX - v_[op.y()];
 
-    v_[x_] = v_[x_] + v_[y_];
+    v_[op.x()] = v_[op.x()] + v_[op.y()];
     if (overflow) {
         // Addition did overflow
         v_[0xF] = 1;  
@@ -111,12 +905,12 @@ void CPU::op_8xy4() {
     }
 }
 
-void CPU::op_8xy5() {
+void CPU::op_8xy5(Opcode op) {
     // Set vx to vx -= vy
     // Calculate underflow up front so VF can be an input
-    bool underflow = v_[x_] < v_[y_];
+    bool underflow = v_[op.x()] < v_[op.y()];
     
-    v_[x_] = v_[x_] - v_[y_];
+    v_[op.x()] = v_[op.x()] - v_[op.y()];
     if (underflow) {
         // Subtraction did underflow
         v_[0xF] = 0;  
@@ -126,11 +920,11 @@ void CPU::op_8xy5() {
     }
 }
 
-void CPU::op_8xy7() {
+void CPU::op_8xy7(Opcode op) {
     // Calculate underflow up front so VF can be an input
-    bool underflow = v_[x_] > v_[y_];
+    bool underflow = v_[op.x()] > v_[op.y()];
 
-    v_[x_] = v_[y_] - v_[x_];
+    v_[op.x()] = v_[op.y()] - v_[op.x()];
     if (underflow) {
         // Subtraction did underflow
         v_[0xF] = 0;  
@@ -140,129 +934,157 @@ void CPU::op_8xy7() {
     }
 }
 
-void CPU::op_8xy6() {
-    // Shift VX right, set VF to LSB
-
-    v_[x_] = v_[y_];
-    uint8_t lsb = v_[x_] & 0x1;
-    v_[x_] = v_[x_]>>1;
+template <Quirks Q>
+void CPU::op_8xy6(Opcode op) {
+    // Shift VY (or VX in place) right into VX, set VF to LSB
+    if constexpr (Q.shift_vy)
+        v_[op.x()] = v_[op.y()];
+    uint8_t lsb = v_[op.x()] & 0x1;
+    v_[op.x()] = v_[op.x()]>>1;
     v_[0xF] = lsb;
 }
 
 
-void CPU::op_8xye() {
-    // Shift VX left, set VF to MSB
-
-    v_[x_] = v_[y_];
-    uint8_t msb = (v_[x_] & 0x80)>>7;
-    v_[x_] = v_[x_]<<1;
+template <Quirks Q>
+void CPU::op_8xye(Opcode op) {
+    // Shift VY (or VX in place) left into VX, set VF to MSB
+    if constexpr (Q.shift_vy)
+        v_[op.x()] = v_[op.y()];
+    uint8_t msb = (v_[op.x()] & 0x80)>>7;
+    v_[op.x()] = v_[op.x()]<<1;
     v_[0xF] = msb;
 }
 
 // ===== Control flow (very common) =====
-void CPU::op_1nnn() {
+void CPU::op_1nnn(Opcode op) {
     // Jump to nnn
-    pc_ = nnn_;
+    pc_ = op.nnn();
 }
 
-void CPU::op_3xnn() {
+template <Quirks Q>
+void CPU::op_3xnn(Opcode op) {
     // Skip the next instruction if vx == nn
-    if (v_[x_] == nn_)
-        pc_+=2;
+    if (v_[op.x()] == op.nn())
+        skip<Q>();
 }
 
-void CPU::op_4xnn() {
+template <Quirks Q>
+void CPU::op_4xnn(Opcode op) {
     // Skip the next instruction if vx != nn
-    if (v_[x_] != nn_)
-        pc_+=2;
+    if (v_[op.x()] != op.nn())
+        skip<Q>();
 }
 
-void CPU::op_5xy0() {
+template <Quirks Q>
+void CPU::op_5xy0(Opcode op) {
     // Skip the next instruction if vx == vy
-    if (v_[x_] == v_[y_])
-        pc_+=2;
+    if (v_[op.x()] == v_[op.y()])
+        skip<Q>();
 }
 
-void CPU::op_9xy0() {
-    if (v_[x_] != v_[y_])
-        pc_+=2;
+template <Quirks Q>
+void CPU::op_9xy0(Opcode op) {
+    if (v_[op.x()] != v_[op.y()])
+        skip<Q>();
 }
 
-void CPU::op_bnnn() {
-    // Jump to nnn + V0
-    pc_ = nnn_ + v_[0];
+template <Quirks Q>
+void CPU::op_bnnn(Opcode op) {
+    // Jump to nnn + V0, or xnn + VX on CHIP-48 and later
+    if constexpr (Q.jump_vx)
+        pc_ = op.nnn() + v_[op.x()];
+    else
+        pc_ = op.nnn() + v_[0];
+}
+
+template <Quirks Q>
+void CPU::skip() {
+    // XO-CHIP's F000 NNNN is the one four byte instruction, and a skip
+    //  steps over all of it (the handler's own +2 comes after this)
+    if constexpr (Q.long_skip) {
+        if (peek_instruction(pc_ + 2) == 0xF000)
+            pc_ += 2;
+    }
+    pc_ += 2;
 }
 
 // ===== Memory and display (common) =====
-void CPU::op_annn() {
-    i_ = nnn_;
+void CPU::op_annn(Opcode op) {
+    i_ = op.nnn();
 }
 
-void CPU::op_cxnn() {
+void CPU::op_cxnn(Opcode op) {
     // Set VX to random number & NN
-    v_[x_] = rand_() & nn_;
+    v_[op.x()] = rand_() & op.nn();
 }
 
-void CPU::op_dxyn() {
-    v_[0xf] = 0;
-
-    uint8_t draw_y = v_[y_] % Utils::PIXEL_HEIGHT;
-
-    for (uint8_t byte_idx = 0; byte_idx < n_; byte_idx++) {
-        if (draw_y >= Utils::PIXEL_HEIGHT) break;
-
-        uint8_t sprite_byte = ram_.read(i_ + byte_idx);
-        uint8_t draw_x = v_[x_] % Utils::PIXEL_WIDTH;
-
-        for (int bit_idx = 7; bit_idx >= 0; bit_idx--) {
-            if (draw_x >= Utils::PIXEL_WIDTH) break;
-
-            if ((sprite_byte >> bit_idx) & 0x1) {
-                // Sprite is turning this bit on 
-                if (peripherals_.check_pixel(draw_x, draw_y)) {
-                    // This bit is already on
-                    v_[0xf] = 1;
-                    peripherals_.set_pixel(draw_x, draw_y, false);
-                } else {
-                    peripherals_.set_pixel(draw_x, draw_y, true);
-                }
-            }
-            draw_x++;
+template <Quirks Q>
+void CPU::op_dxyn(Opcode op) {
+    // N rows of 8 pixels, or a 16x16 sprite for Dxy0 on SUPER-CHIP and later
+    uint8_t rows = op.n();
+    bool wide = false;
+    if constexpr (Q.large_sprites) {
+        if (rows == 0) {
+            rows = 16;
+            wide = true;
         }
-        draw_y++;
     }
+    uint8_t sprite_bytes = wide ? 2 * rows : rows;
+
+    // Every selected plane draws the next sprite's worth of data from I.
+    //  Each sprite row is shifted into place and XORed onto the packed
+    //  plane a word at a time (see Framebuffer::draw).
+    Framebuffer& display = peripherals_.framebuffer;
+    uint32_t address = i_;
+    bool collision = false;
+    for (size_t plane = 0; plane < Framebuffer::PLANES; plane++) {
+        if (!(peripherals_.plane_mask >> plane & 0x1))
+            continue;
+        std::array<uint8_t, 32> sprite;
+        ram_.read_span(address, std::span<uint8_t>(sprite.data(), sprite_bytes));
+        collision |= display.draw<Q.clip_sprites>(plane, v_[op.x()], v_[op.y()], sprite.data(), rows, wide);
+        address += sprite_bytes;
+    }
+    v_[0xf] = collision;
 
     draw_flag = true;
+
+    // The VIP draws in the vertical blank, so the program sees at most one
+    //  sprite per frame
+    if constexpr (Q.display_wait)
+        frame_wait_ = true;
 }
 
 // ===== Subroutines (moderately common) =====
-void CPU::op_2nnn() {
+void CPU::op_2nnn(Opcode op) {
     // Call subroutine at nnn
     push_stack(pc_);
-    pc_ = nnn_;
+    pc_ = op.nnn();
 }
 
-void CPU::op_00ee() {
+void CPU::op_00ee(Opcode) {
     // Return from subroutine
     pc_ = pop_stack();
 }
 
 // ===== Input handling (moderately common) =====
-void CPU::op_ex9e() {
+template <Quirks Q>
+void CPU::op_ex9e(Opcode op) {
     // Skip if VX-key is pressed
-    if (peripherals_.key_state[v_[x_]]) {
-        pc_+=2;
+    if (peripherals_.key_state[v_[op.x()]]) {
+        skip<Q>();
     }
 }
 
-void CPU::op_exa1() {
+template <Quirks Q>
+void CPU::op_exa1(Opcode op) {
     // Skip if VX-key is not pressed
-    if (!peripherals_.key_state[v_[x_]]) {
-        pc_+=2;
+    if (!peripherals_.key_state[v_[op.x()]]) {
+        skip<Q>();
     }
 }
 
-void CPU::op_fx0a() {
+void CPU::op_fx0a(Opcode op) {
     // Wait for key press, store in VX
     if (!waiting_for_key_) {
         // First time through, register x value
@@ -274,73 +1096,164 @@ void CPU::op_fx0a() {
         if (peripherals_.input_flag) {
             waiting_for_key_ = false;
             peripherals_.input_flag = false;
-            v_[x_] = peripherals_.last_key;
+            v_[op.x()] = peripherals_.last_key;
             pc_+=2;
         }
     }
 }
 
 // ===== Timers and utility (less common) =====
-void CPU::op_fx07() {
+void CPU::op_fx07(Opcode op) {
     // Set VX to delay timer
-    v_[x_] = delay_timer_.get();
+    v_[op.x()] = delay_timer_.get();
 }
 
-void CPU::op_fx15() {
+void CPU::op_fx15(Opcode op) {
     // Set delay timer to VX
-    delay_timer_.set(v_[x_]);
+    delay_timer_.set(v_[op.x()]);
 }
 
-void CPU::op_fx18() {
+void CPU::op_fx18(Opcode op) {
     // Set sound timer to VX
-    sound_timer_.set(v_[x_]);
+    sound_timer_.set(v_[op.x()]);
 }
 
-void CPU::op_fx1e() {
+void CPU::op_fx1e(Opcode op) {
     // Set I to I + VX
 
     // Calculate overflow up front so VF can be an input
-    bool overflow = i_ > UINT8_MAX - v_[x_];
-    i_ = i_ + v_[x_];
+    bool overflow = i_ > UINT8_MAX - v_[op.x()];
+    i_ = i_ + v_[op.x()];
 
     if (overflow) {
         v_[0xF] = 1;
     }
 }
 
-void CPU::op_fx29() {
-    // Set I to font character X
-    i_ = Utils::FONT_START_ADDRESS + x_ * 5; //Each font char is 5 bytes 
+void CPU::op_fx29(Opcode op) {
+    // Set I to font character VX
+    i_ = font_address(v_[op.x()]);
 }
 
-void CPU::op_fx33() {
+void CPU::op_fx33(Opcode op) {
     // Store BCD of VX at I, I+1, I+2
-
-    // Note: ugly BCD algo, but there you go
-    uint8_t d1 = v_[x_] % 10;
-    uint8_t d10 = ((v_[x_] % 100) - d1)/10;
-    uint8_t d100 = ((v_[x_] % 1000) - d1 - d10)/100;
-    ram_.write(i_, d100);
-    ram_.write(i_+1, d10);
-    ram_.write(i_+2, d1);
+    ram_.write_span(i_, bcd(v_[op.x()]));
 }
 
-void CPU::op_fx55() {
+template <Quirks Q>
+void CPU::op_fx55(Opcode op) {
     // Store V0-VX to memory starting at I
-    for (uint8_t iter = 0; iter <= x_; iter++) {
-        ram_.write(i_++, v_[iter]);
-    }
+    ram_.write_span(i_, std::span<const uint8_t>(v_, op.x() + 1));
+    i_ += index_increment<Q>(op.x());
 }
 
-void CPU::op_fx65() {
-    // TODO: Load V0-VX from memory starting at I
-    for (uint8_t iter = 0; iter <= x_; iter++) {
-        v_[iter] = ram_.read(i_++);
-    }
+template <Quirks Q>
+void CPU::op_fx65(Opcode op) {
+    // Load V0-VX from memory starting at I
+    ram_.read_span(i_, std::span<uint8_t>(v_, op.x() + 1));
+    i_ += index_increment<Q>(op.x());
 }
 
 // ===== System operations (least common) =====
-void CPU::op_00e0() {
+void CPU::op_00e0(Opcode) {
     peripherals_.clear_pixel_buffer();
     draw_flag = true;
-}
\ No newline at end of file
+}
+
+// ===== SUPER-CHIP =====
+void CPU::op_00cn(Opcode op) {
+    // Scroll the selected planes down N rows
+    peripherals_.framebuffer.scroll_down(op.n(), peripherals_.plane_mask);
+    draw_flag = true;
+}
+
+void CPU::op_00fb(Opcode) {
+    peripherals_.framebuffer.scroll_right(peripherals_.plane_mask);
+    draw_flag = true;
+}
+
+void CPU::op_00fc(Opcode) {
+    peripherals_.framebuffer.scroll_left(peripherals_.plane_mask);
+    draw_flag = true;
+}
+
+void CPU::op_00fd(Opcode) {
+    // Exit the interpreter: PC stays put, so the program halts here
+    exited_ = true;
+}
+
+void CPU::op_00fe(Opcode) {
+    // Switching resolution clears the screen
+    peripherals_.framebuffer.set_hires(false);
+    draw_flag = true;
+}
+
+void CPU::op_00ff(Opcode) {
+    peripherals_.framebuffer.set_hires(true);
+    draw_flag = true;
+}
+
+void CPU::op_fx30(Opcode op) {
+    // Set I to hires font character VX
+    i_ = hires_font_address(v_[op.x()]);
+}
+
+void CPU::op_fx75(Opcode op) {
+    // Store V0-VX in the flag registers
+    std::copy_n(v_, op.x() + 1, flags_.begin());
+}
+
+void CPU::op_fx85(Opcode op) {
+    // Load V0-VX from the flag registers
+    std::copy_n(flags_.begin(), op.x() + 1, v_);
+}
+
+// ===== XO-CHIP =====
+void CPU::op_00dn(Opcode op) {
+    // Scroll the selected planes up N rows
+    peripherals_.framebuffer.scroll_up(op.n(), peripherals_.plane_mask);
+    draw_flag = true;
+}
+
+void CPU::op_5xy2(Opcode op) {
+    // Store VX-VY (in either direction) to memory starting at I, I unchanged
+    uint8_t count = (op.x() <= op.y() ? op.y() - op.x() : op.x() - op.y()) + 1;
+    std::array<uint8_t, 16> values;
+    for (uint8_t offset = 0; offset < count; offset++) {
+        values[offset] = v_[op.x() <= op.y() ? op.x() + offset : op.x() - offset];
+    }
+    ram_.write_span(i_, std::span<const uint8_t>(values.data(), count));
+}
+
+void CPU::op_5xy3(Opcode op) {
+    // Load VX-VY (in either direction) from memory starting at I, I unchanged
+    uint8_t count = (op.x() <= op.y() ? op.y() - op.x() : op.x() - op.y()) + 1;
+    std::array<uint8_t, 16> values;
+    ram_.read_span(i_, std::span<uint8_t>(values.data(), count));
+    for (uint8_t offset = 0; offset < count; offset++) {
+        v_[op.x() <= op.y() ? op.x() + offset : op.x() - offset] = values[offset];
+    }
+}
+
+void CPU::op_f000(Opcode) {
+    // Set I to the 16-bit address in the next word, then step over both
+    i_ = ram_.read(pc_ + 2) << 8 | ram_.read(pc_ + 3);
+    pc_ += 4;
+}
+
+void CPU::op_fn01(Opcode op) {
+    // Select the planes later draws, clears and scrolls apply to
+    peripherals_.plane_mask = op.x() & ((1u << Framebuffer::PLANES) - 1);
+}
+
+void CPU::op_f002(Opcode) {
+    // Load the 16 byte (128 sample) audio pattern from I
+    ram_.read_span(i_, peripherals_.audio_buffer);
+    peripherals_.audio_changed = true;
+}
+
+void CPU::op_fx3a(Opcode op) {
+    // Set the pattern playback pitch
+    peripherals_.audio_pitch = v_[op.x()];
+    peripherals_.audio_changed = true;
+}
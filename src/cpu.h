@@ -3,20 +3,126 @@
 #include "ram.h"
 #include "peripherals.h"
 #include "timer.h"
+#include "jit.h"
+#include "quirks.h"
 
-#include <vector>
+#include <array>
+#include <exception>
+#include <memory>
 #include <random>
+#include <vector>
+
+template <size_t Lanes> class Lockstep;
+class GuestProfiler;
 
 class CPU {
 public:
+    // Execution engines selectable at runtime
+    enum class Engine {
+        Interpreter,    // Fetch, decode and dispatch every instruction
+        Cached,         // Run pre-decoded basic blocks from the block cache
+        Jit,            // Compile hot blocks to native x86-64 (falls back to Cached)
+        Aot,            // Run a ROM compiled in by chip8-aot (falls back to Cached)
+    };
+
     CPU(Peripherals& peripherals, RAM& ram, Timer& delay_timer, Timer& sound_timer);
+    ~CPU();
+
+    void reset();               // Reset the CPU state
+    void cycle();               // Execute a single cycle of the CPU
+    void run(uint32_t cycles);  // Execute a batch of cycles back-to-back
+
+    // Busy-wait loops the program can sit in. Cycles spent in them change
+    //  nothing until a timer ticks or input arrives, so run() skips them.
+    enum class Idle {
+        None,
+        Halted,         // 1nnn jumping to itself
+        DelayTimer,     // Fx07/3x00/1nnn polling a non-zero delay timer
+        Key,            // Fx0A waiting for a key press
+    };
+    Idle idle() const;  // What the program is waiting on at pc_, if anything
+    uint64_t idle_cycles() const { return idle_cycles_; }   // Cycles skipped so far
+
+    void set_engine(Engine engine) { engine_ = engine; }
+    Engine engine() const { return engine_; }
+
+    // Platform quirks, picked per ROM. Each profile runs its own compiled
+    //  copy of the execution core.
+    void set_profile(Profile profile);
+    Profile profile() const { return profile_; }
+    void vblank() { frame_wait_ = false; }  // Frame boundary: ends a Dxyn display wait
+    bool exited() const { return exited_; } // The program ran 00FD (SUPER-CHIP exit)
+
+    void seed(uint32_t seed) { rand_.seed(seed); }  // Reseed the Cxnn random stream
 
-    void reset(); // Reset the CPU state
-    void cycle(); // Execute a single cycle of the CPU
+    // Save states: registers, stack, random stream and wait status. Memory
+    //  and the profile are saved alongside (see save_state.h).
+    struct State {
+        std::array<uint8_t, 16> v;
+        uint16_t i;
+        uint16_t pc;
+        uint16_t sp;
+        std::array<uint16_t, Utils::STACK_DEPTH> stack;
+        std::array<uint8_t, Utils::FLAG_REGISTERS> flags;
+        std::minstd_rand rand;
+        bool waiting_for_key;
+        bool frame_wait;
+        bool exited;
+        bool draw_flag;
+    };
+    void save(State& state) const;
+    void load(const State& state);
 
     bool draw_flag = false; // Flag indicating that display render is needed
 
+    // Interface for ROMs translated ahead of time by chip8-aot. Generated
+    //  code works on the registers directly and hands anything stateful
+    //  back to the interpreter through execute().
+    struct AotContext {
+        uint8_t* v;
+        uint16_t& i;
+        uint16_t& pc;
+        Peripherals& peripherals;
+        Timer& delay_timer;
+        Timer& sound_timer;
+        CPU& cpu;
+
+        void execute(uint16_t opcode) { cpu.execute(Opcode{opcode}); }
+        void call(uint16_t address) { cpu.push_stack(address); }
+        uint16_t ret() { return cpu.pop_stack(); }
+        bool code_modified() const { return cpu.aot_code_modified_; }
+        bool check_code_writes() { return cpu.check_aot_code_writes(); }
+        bool code_intact(uint16_t address, const uint8_t* bytes, uint16_t length) const;
+    };
+    struct AotCodeRange {
+        uint16_t start;     // First translated address
+        uint16_t end;       // One past the last translated byte
+    };
+    struct AotProgram {
+        const char* name;
+        uint32_t rom_hash;                  // Utils::fnv1a of the ROM image
+        uint16_t rom_size;
+        uint32_t (*run)(AotContext& ctx, uint32_t cycles); // Returns cycles executed
+        const AotCodeRange* code_ranges;    // Translated code, watched for writes
+        size_t code_range_count;
+    };
+    static bool register_aot_program(const AotProgram* program);
+    bool load_aot_program(uint16_t address, uint16_t size); // Attach a matching program
+
+    // Guest profiling (see guest_profiler.h). While a profiler is attached
+    //  the interpreter runs whatever the engine, in a separate instantiation
+    //  that feeds it every instruction; without one that code never runs.
+    void set_profiler(GuestProfiler* profiler) { profiler_ = profiler; }
+    static const char* opcode_name(uint8_t index);  // e.g. "8xy4", for reports
+
+    // Superinstruction statistics (cached engine)
+    static constexpr size_t FUSED_FORM_COUNT = 4;
+    static const char* fused_form_name(size_t form) { return fused_forms_[form].name; }
+    uint64_t fused_count(size_t form) const { return fused_counts_[form]; }
+
 private:
+    // Lockstep hands registers between its SIMD lanes and per-lane CPUs
+    template <size_t Lanes> friend class Lockstep;
 
     // Dependency injection objects
     Peripherals& peripherals_;
@@ -32,132 +138,321 @@ private:
     uint16_t i_ = 0;                               // Index Register
     uint8_t v_[16] = {};                           // General Purpose Registers
 
-    // Utility var parsers
-    uint8_t x_;
-    uint8_t y_;
-    uint8_t n_;
-    uint8_t nn_;
-    uint16_t nnn_;
+    std::array<uint8_t, Utils::FLAG_REGISTERS> flags_{};    // SUPER-CHIP RPL user flags
 
     bool waiting_for_key_ = false;
+    bool frame_wait_ = false;       // Dxyn is waiting for the next frame (display_wait quirk)
+    bool exited_ = false;           // 00FD ran
+
+    Engine engine_ = Engine::Interpreter;
+    Profile profile_ = Profile::Modern;
+    GuestProfiler* profiler_ = nullptr;
+
+    // Raw opcode with on-demand operand decoding, so handlers only pay
+    //  for the fields they actually use
+    struct Opcode {
+        uint16_t raw;
+        constexpr uint8_t x() const { return (raw & 0x0F00) >> 8; }
+        constexpr uint8_t y() const { return (raw & 0x00F0) >> 4; }
+        constexpr uint8_t n() const { return raw & 0x000F; }
+        constexpr uint8_t nn() const { return raw & 0x00FF; }
+        constexpr uint16_t nnn() const { return raw & 0x0FFF; }
+    };
 
     void push_stack(uint16_t address);
     uint16_t pop_stack();
     uint16_t fetch_instruction();
-    void parse_args(uint16_t opcode);
+    uint16_t peek_instruction(int address) const;   // 0 (invalid) outside of memory
+    bool delay_loop_start(uint16_t& start) const;   // Fx07/3x00/1nnn loop around pc_
+    uint32_t skip_idle(uint32_t cycles);            // Fast-forward an idle loop, returns cycles used
+    uint64_t idle_cycles_ = 0;
+    static uint8_t decode(Opcode opcode); // Index into opcode_handlers_
+    void execute(Opcode opcode);          // Decode and run one instruction (active profile)
+    static constexpr bool writes_memory(uint8_t index); // Opcode can write RAM
+    static constexpr bool draws(uint8_t index);         // Opcode is Dxyn
 
-    using OpcodeHandler = void (CPU::*)();
+    // The execution core, instantiated once per profile
+    template <typename Fn>
+    void with_profile(Fn&& fn);     // Calls fn.template operator()<Q>() for the active profile
+    template <Quirks Q> void cycle();
+    template <Quirks Q> void execute(Opcode opcode);
+    template <Quirks Q> void execute_index(uint8_t index, Opcode opcode); // Run a pre-decoded instruction
+    template <Quirks Q, uint8_t Index>
+    void execute_as(Opcode opcode);
+
+    template <Quirks Q> void run_engine(uint32_t cycles);
+    template <Quirks Q, bool Profiled = false> void run_interpreter(uint32_t cycles);
+    template <Quirks Q> void profile_instruction(uint8_t index, Opcode opcode);  // Before it runs
+    template <Quirks Q> void run_cached(uint32_t cycles);
+    template <Quirks Q> void run_jit(uint32_t cycles);
+    template <Quirks Q> void run_aot(uint32_t cycles);
+
+    using OpcodeHandler = void (CPU::*)(Opcode);
     struct OpcodeInfo {
         uint16_t pattern = 0;
         uint16_t mask = 0;
         OpcodeHandler handler = nullptr;
         bool auto_increment_pc = true;
+        bool ends_block = false;    // Jumps, skips, calls and returns end a decoded block
+        const char* name = "";      // e.g. "8xy4", for reports
     };
 
     std::minstd_rand rand_;
 
 
-    // Opcodes (most to least commonly used)
+    // Opcodes (grouped by how commonly they are used)
 
     // Register operations (most common)
-    void op_6xnn(); // Set VX to NN
-    void op_7xnn(); // Set VX to VX + NN
-    void op_8xy0(); // Set VX to VY
-    void op_8xy1(); // Set VX to VX | VY
-    void op_8xy2(); // Set VX to VX & VY
-    void op_8xy3(); // Set VX to VX ^ VY
-    void op_8xy4(); // Set VX to VX + VY
-    void op_8xy5(); // Set VX to VX - VY
-    void op_8xy7(); // Set VX to VY - VX
-    void op_8xy6(); // Shift VX right (NOTE: modern interpretation)
-    void op_8xye(); // Shift VX left (NOTE: modern interpretation)
+    void op_6xnn(Opcode op); // Set VX to NN
+    void op_7xnn(Opcode op); // Set VX to VX + NN
+    void op_8xy0(Opcode op); // Set VX to VY
+    template <Quirks Q> void op_8xy1(Opcode op); // Set VX to VX | VY (vf_reset)
+    template <Quirks Q> void op_8xy2(Opcode op); // Set VX to VX & VY (vf_reset)
+    template <Quirks Q> void op_8xy3(Opcode op); // Set VX to VX ^ VY (vf_reset)
+    void op_8xy4(Opcode op); // Set VX to VX + VY
+    void op_8xy5(Opcode op); // Set VX to VX - VY
+    void op_8xy7(Opcode op); // Set VX to VY - VX
+    template <Quirks Q> void op_8xy6(Opcode op); // Shift VX right (shift_vy)
+    template <Quirks Q> void op_8xye(Opcode op); // Shift VX left (shift_vy)
 
     // Control flow operations (very common)
-    void op_1nnn(); // Jump
-    void op_3xnn(); // Skip if VX == NN
-    void op_4xnn(); // Skip if VX != NN
-    void op_5xy0(); // Skip if VX == VY
-    void op_9xy0(); // Skip if VX != VY
-    void op_bnnn(); // Jump plus offset (NOTE: original interpretation)
+    void op_1nnn(Opcode op); // Jump
+    template <Quirks Q> void op_3xnn(Opcode op); // Skip if VX == NN
+    template <Quirks Q> void op_4xnn(Opcode op); // Skip if VX != NN
+    template <Quirks Q> void op_5xy0(Opcode op); // Skip if VX == VY
+    template <Quirks Q> void op_9xy0(Opcode op); // Skip if VX != VY
+    template <Quirks Q> void op_bnnn(Opcode op); // Jump plus offset (jump_vx)
+    template <Quirks Q> void skip();             // Step over the next instruction (long_skip)
 
     // Memory and display (common)
-    void op_annn(); // Set I to NNN
-    void op_dxyn(); // Display
-    void op_cxnn(); // Set VX to Rand() & NN
+    void op_annn(Opcode op); // Set I to NNN
+    template <Quirks Q> void op_dxyn(Opcode op); // Display (clip_sprites, display_wait, large_sprites)
+    void op_cxnn(Opcode op); // Set VX to Rand() & NN
 
     // Subroutines (moderately common)
-    void op_2nnn(); // Subroutine Start
-    void op_00ee(); // Subroutine Return
+    void op_2nnn(Opcode op); // Subroutine Start
+    void op_00ee(Opcode op); // Subroutine Return
     
     // Input handling (moderately common)
-    void op_ex9e(); // Skip if VX-key is pressed
-    void op_exa1(); // Skip if VX-key is not pressed
-    void op_fx0a(); // Wait for VX-key
+    template <Quirks Q> void op_ex9e(Opcode op); // Skip if VX-key is pressed
+    template <Quirks Q> void op_exa1(Opcode op); // Skip if VX-key is not pressed
+    void op_fx0a(Opcode op); // Wait for VX-key
 
     // Timers and utility (less common)
-    void op_fx07(); // Set VX to DT (delay timer)
-    void op_fx15(); // Set DT to VX
-    void op_fx18(); // Set ST (sound timer) to VX
-    void op_fx1e(); // Set I to I + VX
-    void op_fx29(); // Set I to VX-font-character
-    void op_fx33(); // BCD VX into I, I+1, and I+2
-    void op_fx55(); // Store V0 through VX to addresses I to I+X (NOTE: modern)
-    void op_fx65(); // Store values at I to I+X to V0 through VX (NOTE: modern)
+    void op_fx07(Opcode op); // Set VX to DT (delay timer)
+    void op_fx15(Opcode op); // Set DT to VX
+    void op_fx18(Opcode op); // Set ST (sound timer) to VX
+    void op_fx1e(Opcode op); // Set I to I + VX
+    void op_fx29(Opcode op); // Set I to VX-font-character
+    void op_fx33(Opcode op); // BCD VX into I, I+1, and I+2
+    template <Quirks Q> void op_fx55(Opcode op); // Store V0 through VX to addresses I to I+X (memory_increment)
+    template <Quirks Q> void op_fx65(Opcode op); // Store values at I to I+X to V0 through VX (memory_increment)
+
+    // Operand arithmetic shared with Lockstep's SIMD lanes
+    static constexpr uint16_t font_address(uint8_t vx) {
+        return Utils::FONT_START_ADDRESS + (vx & 0xF) * 5;          // Each font char is 5 bytes
+    }
+    static constexpr uint16_t hires_font_address(uint8_t vx) {
+        return Utils::HIRES_FONT_START_ADDRESS + (vx & 0xF) * 10;   // Each hires char is 10 bytes
+    }
+    static constexpr std::array<uint8_t, 3> bcd(uint8_t value) {
+        return {static_cast<uint8_t>(value / 100), static_cast<uint8_t>(value / 10 % 10), static_cast<uint8_t>(value % 10)};
+    }
+    template <Quirks Q>
+    static constexpr uint8_t index_increment(uint8_t x) {  // How far Fx55/Fx65 move I
+        using enum Quirks::IndexIncrement;
+        if constexpr (Q.memory_increment == XPlusOne)
+            return x + 1;
+        else if constexpr (Q.memory_increment == X)
+            return x;
+        else
+            return 0;
+    }
 
     // System operations (least common)
-    void op_00e0(); // Clear Screen
+    void op_00e0(Opcode op); // Clear Screen
 
-    const std::vector<OpcodeInfo>opcode_handlers_ = {
+    // SUPER-CHIP
+    void op_00cn(Opcode op); // Scroll down N rows
+    void op_00fb(Opcode op); // Scroll right 4 pixels
+    void op_00fc(Opcode op); // Scroll left 4 pixels
+    void op_00fd(Opcode op); // Exit
+    void op_00fe(Opcode op); // Lores (64x32)
+    void op_00ff(Opcode op); // Hires (128x64)
+    void op_fx30(Opcode op); // Set I to VX-hires-font-character
+    void op_fx75(Opcode op); // Store V0 through VX to the flag registers
+    void op_fx85(Opcode op); // Load V0 through VX from the flag registers
+
+    // XO-CHIP
+    void op_00dn(Opcode op); // Scroll up N rows
+    void op_5xy2(Opcode op); // Store VX through VY to addresses from I
+    void op_5xy3(Opcode op); // Load VX through VY from addresses from I
+    void op_f000(Opcode op); // Set I to the 16-bit word that follows
+    void op_fn01(Opcode op); // Select bitplanes N
+    void op_f002(Opcode op); // Load the audio pattern from I
+    void op_fx3a(Opcode op); // Set audio pitch to VX
+
+    // Handlers as seen by profile Q; the patterns, masks and flags are the
+    //  same for every profile
+    template <Quirks Q>
+    static constexpr std::array<OpcodeInfo, 50> opcode_table_ = {{
         /*
-         Match   Mask    Handler        Auto-Inc PC
+         Match   Mask    Handler        Auto-Inc Ends-Block Name
         */
         // Register operations (most common - executed constantly)
-        {0x6000, 0xF000, &CPU::op_6xnn, true},   // 6xnn - Set VX
-        {0x7000, 0xF000, &CPU::op_7xnn, true},   // 7xnn - Add to VX
-        {0x8000, 0xF00F, &CPU::op_8xy0, true},   // 8xy0 - Set VX to VY
-        {0x8004, 0xF00F, &CPU::op_8xy4, true},   // 8xy4 - Set VX to VX + VY
-        {0x8005, 0xF00F, &CPU::op_8xy5, true},   // 8xy5 - Set VX to VX - VY
-        {0x8001, 0xF00F, &CPU::op_8xy1, true},   // 8xy1 - Set VX to VX | VY
-        {0x8002, 0xF00F, &CPU::op_8xy2, true},   // 8xy2 - Set VX to VX & VY
-        {0x8003, 0xF00F, &CPU::op_8xy3, true},   // 8xy3 - Set VX to VX ^ VY
-        {0x8007, 0xF00F, &CPU::op_8xy7, true},   // 8xy7 - Set VX to VY - VX
-        {0x8006, 0xF00F, &CPU::op_8xy6, true},   // 8xy6 - Shift VX right
-        {0x800e, 0xF00F, &CPU::op_8xye, true},   // 8xye - Shift VX left
+        {0x6000, 0xF000, &CPU::op_6xnn, true,  false, "6xnn"},  // 6xnn - Set VX
+        {0x7000, 0xF000, &CPU::op_7xnn, true,  false, "7xnn"},  // 7xnn - Add to VX
+        {0x8000, 0xF00F, &CPU::op_8xy0, true,  false, "8xy0"},  // 8xy0 - Set VX to VY
+        {0x8004, 0xF00F, &CPU::op_8xy4, true,  false, "8xy4"},  // 8xy4 - Set VX to VX + VY
+        {0x8005, 0xF00F, &CPU::op_8xy5, true,  false, "8xy5"},  // 8xy5 - Set VX to VX - VY
+        {0x8001, 0xF00F, &CPU::op_8xy1<Q>, true,  false, "8xy1"},  // 8xy1 - Set VX to VX | VY
+        {0x8002, 0xF00F, &CPU::op_8xy2<Q>, true,  false, "8xy2"},  // 8xy2 - Set VX to VX & VY
+        {0x8003, 0xF00F, &CPU::op_8xy3<Q>, true,  false, "8xy3"},  // 8xy3 - Set VX to VX ^ VY
+        {0x8007, 0xF00F, &CPU::op_8xy7, true,  false, "8xy7"},  // 8xy7 - Set VX to VY - VX
+        {0x8006, 0xF00F, &CPU::op_8xy6<Q>, true,  false, "8xy6"},  // 8xy6 - Shift VX right
+        {0x800e, 0xF00F, &CPU::op_8xye<Q>, true,  false, "8xye"},  // 8xye - Shift VX left
         
         // Control flow (very common)
-        {0x1000, 0xF000, &CPU::op_1nnn, false},  // 1nnn - Jump
-        {0x3000, 0xF000, &CPU::op_3xnn, true},   // 3xnn - Skip if VX == NN
-        {0x4000, 0xF000, &CPU::op_4xnn, true},   // 4xnn - Skip if VX != NN
-        {0x5000, 0xF00F, &CPU::op_5xy0, true},   // 5xy0 - Skip if VX == VY
-        {0x9000, 0xF00F, &CPU::op_9xy0, true},   // 9xy0 - Skip if VX != VY
-        {0xb000, 0xF000, &CPU::op_bnnn, false},  // bnnn - Jump plus offset
+        {0x1000, 0xF000, &CPU::op_1nnn, false, true , "1nnn"},  // 1nnn - Jump
+        {0x3000, 0xF000, &CPU::op_3xnn<Q>, true,  true , "3xnn"},  // 3xnn - Skip if VX == NN
+        {0x4000, 0xF000, &CPU::op_4xnn<Q>, true,  true , "4xnn"},  // 4xnn - Skip if VX != NN
+        {0x5000, 0xF00F, &CPU::op_5xy0<Q>, true,  true , "5xy0"},  // 5xy0 - Skip if VX == VY
+        {0x9000, 0xF00F, &CPU::op_9xy0<Q>, true,  true , "9xy0"},  // 9xy0 - Skip if VX != VY
+        {0xb000, 0xF000, &CPU::op_bnnn<Q>, false, true , "bnnn"},  // bnnn - Jump plus offset
         
         // Memory and display (common)
-        {0xa000, 0xF000, &CPU::op_annn, true},   // annn - Set I
-        {0xd000, 0xF000, &CPU::op_dxyn, true},   // dxyn - Display
-        {0xc000, 0xF000, &CPU::op_cxnn, true},   // cxnn - Set VX to Rand() & NN
+        {0xa000, 0xF000, &CPU::op_annn, true,  false, "annn"},  // annn - Set I
+        {0xd000, 0xF000, &CPU::op_dxyn<Q>, true,  false, "dxyn"},  // dxyn - Display
+        {0xc000, 0xF000, &CPU::op_cxnn, true,  false, "cxnn"},  // cxnn - Set VX to Rand() & NN
         
         // Subroutines (moderately common)
-        {0x2000, 0xF000, &CPU::op_2nnn, false},  // 2nnn - Subroutine Start  
-        {0x00ee, 0xFFFF, &CPU::op_00ee, true},   // 00ee - Subroutine Return
+        {0x2000, 0xF000, &CPU::op_2nnn, false, true , "2nnn"},  // 2nnn - Subroutine Start  
+        {0x00ee, 0xFFFF, &CPU::op_00ee, true,  true , "00ee"},  // 00ee - Subroutine Return
         
         // Input handling (moderately common)
-        {0xe09e, 0xF0FF, &CPU::op_ex9e, true},   // ex9e - Skip if VX-key is pressed
-        {0xe0a1, 0xF0FF, &CPU::op_exa1, true},   // exa1 - Skip if VX-key is not pressed
-        {0xf00a, 0xF0FF, &CPU::op_fx0a, false},   // fx0a - Get key (blocking)
+        {0xe09e, 0xF0FF, &CPU::op_ex9e<Q>, true,  true , "ex9e"},  // ex9e - Skip if VX-key is pressed
+        {0xe0a1, 0xF0FF, &CPU::op_exa1<Q>, true,  true , "exa1"},  // exa1 - Skip if VX-key is not pressed
+        {0xf00a, 0xF0FF, &CPU::op_fx0a, false, true , "fx0a"},  // fx0a - Get key (blocking)
         
         // Timers and utility (less common)
-        {0xf007, 0xF0FF, &CPU::op_fx07, true},   // fx07 - Set VX to DT
-        {0xf015, 0xF0FF, &CPU::op_fx15, true},   // fx15 - Set DT to VX
-        {0xf018, 0xF0FF, &CPU::op_fx18, true},   // fx18 - Set ST to VX
-        {0xf01e, 0xF0FF, &CPU::op_fx1e, true},   // fx1e - Set I to I + VX
-        {0xf029, 0xF0FF, &CPU::op_fx29, true},   // fx29 - Set I to VX-font-character
-        {0xf033, 0xF0FF, &CPU::op_fx33, true},   // fx33 - BCD VX into I, I+1, I+2
-        {0xf055, 0xF0FF, &CPU::op_fx55, true},   // fx55 - Store V0-VX to memory
-        {0xf065, 0xF0FF, &CPU::op_fx65, true},   // fx65 - Load V0-VX from memory
+        {0xf007, 0xF0FF, &CPU::op_fx07, true,  false, "fx07"},  // fx07 - Set VX to DT
+        {0xf015, 0xF0FF, &CPU::op_fx15, true,  false, "fx15"},  // fx15 - Set DT to VX
+        {0xf018, 0xF0FF, &CPU::op_fx18, true,  false, "fx18"},  // fx18 - Set ST to VX
+        {0xf01e, 0xF0FF, &CPU::op_fx1e, true,  false, "fx1e"},  // fx1e - Set I to I + VX
+        {0xf029, 0xF0FF, &CPU::op_fx29, true,  false, "fx29"},  // fx29 - Set I to VX-font-character
+        {0xf033, 0xF0FF, &CPU::op_fx33, true,  false, "fx33"},  // fx33 - BCD VX into I, I+1, I+2
+        {0xf055, 0xF0FF, &CPU::op_fx55<Q>, true,  false, "fx55"},  // fx55 - Store V0-VX to memory
+        {0xf065, 0xF0FF, &CPU::op_fx65<Q>, true,  false, "fx65"},  // fx65 - Load V0-VX from memory
         
         // System operations (least common)
-        {0x00e0, 0xFFFF, &CPU::op_00e0, true},   // 00e0 - Clear Screen
+        {0x00e0, 0xFFFF, &CPU::op_00e0, true,  false, "00e0"},  // 00e0 - Clear Screen
+
+        // SUPER-CHIP
+        {0x00c0, 0xFFF0, &CPU::op_00cn, true,  false, "00cn"},  // 00cn - Scroll down N rows
+        {0x00fb, 0xFFFF, &CPU::op_00fb, true,  false, "00fb"},  // 00fb - Scroll right 4 pixels
+        {0x00fc, 0xFFFF, &CPU::op_00fc, true,  false, "00fc"},  // 00fc - Scroll left 4 pixels
+        {0x00fd, 0xFFFF, &CPU::op_00fd, false, true , "00fd"},  // 00fd - Exit
+        {0x00fe, 0xFFFF, &CPU::op_00fe, true,  false, "00fe"},  // 00fe - Lores
+        {0x00ff, 0xFFFF, &CPU::op_00ff, true,  false, "00ff"},  // 00ff - Hires
+        {0xf030, 0xF0FF, &CPU::op_fx30, true,  false, "fx30"},  // fx30 - Set I to VX-hires-font-character
+        {0xf075, 0xF0FF, &CPU::op_fx75, true,  false, "fx75"},  // fx75 - Store V0-VX to flags
+        {0xf085, 0xF0FF, &CPU::op_fx85, true,  false, "fx85"},  // fx85 - Load V0-VX from flags
+
+        // XO-CHIP
+        {0x00d0, 0xFFF0, &CPU::op_00dn, true,  false, "00dn"},  // 00dn - Scroll up N rows
+        {0x5002, 0xF00F, &CPU::op_5xy2, true,  false, "5xy2"},  // 5xy2 - Store VX-VY to memory
+        {0x5003, 0xF00F, &CPU::op_5xy3, true,  false, "5xy3"},  // 5xy3 - Load VX-VY from memory
+        {0xf000, 0xFFFF, &CPU::op_f000, false, true , "f000"},  // f000 - Set I to the next word (4 bytes long)
+        {0xf001, 0xF0FF, &CPU::op_fn01, true,  false, "fn01"},  // fn01 - Select bitplanes
+        {0xf002, 0xFFFF, &CPU::op_f002, true,  false, "f002"},  // f002 - Load audio pattern
+        {0xf03a, 0xF0FF, &CPU::op_fx3a, true,  false, "fx3a"},  // fx3a - Set audio pitch
+    }};
+    static constexpr const std::array<OpcodeInfo, 50>& opcode_handlers_ = opcode_table_<profile_quirks(Profile::Modern)>;
+
+    // O(1) decode table built at compile time from opcode_handlers_.
+    //  Indexed by the top nibble, then by the low byte (the sub-op), each
+    //  entry holds an index into opcode_handlers_ or INVALID_OPCODE.
+    static constexpr uint8_t INVALID_OPCODE = opcode_handlers_.size();
+    using DispatchTable = std::array<std::array<uint8_t, 256>, 16>;
+    static const DispatchTable dispatch_table_;
+    static consteval DispatchTable build_dispatch_table();
+
+    // Block cache: straight-line runs of code, decoded once and keyed by
+    //  start PC. Blocks end at the first jump, skip, call or return.
+    struct MicroOp {
+        Opcode opcode{};
+        bool auto_increment_pc = true;
+        uint8_t index = INVALID_OPCODE;     // Index into opcode_handlers_ (or FUSED_INDEX_BASE + form)
+        std::array<Opcode, 2> fused{};      // Following opcodes folded into a fused op
+    };
+    struct DecodedBlock {
+        uint16_t start = 0;         // First address of the block
+        uint32_t end = 0;           // One past the last decoded byte
+        std::vector<MicroOp> ops;
+        std::vector<MicroOp> fused_ops;     // ops after superinstruction fusion (cached engine)
+        uint32_t hits = 0;                  // Executions before JIT compilation
+        JIT::BlockFn native = nullptr;      // Compiled code (JIT engine only)
     };
+    std::vector<std::unique_ptr<DecodedBlock>> block_cache_; // Sized to the profile's memory on first use
+    DecodedBlock unreachable_block_;    // Stands in for addresses past it, always empty
+    uint32_t longest_block_ = 0;    // Bytes in the longest cached block, bounds invalidation scans
+
+    DecodedBlock& lookup_block(uint16_t address);
+    std::unique_ptr<DecodedBlock> decode_block(uint16_t address);
+    void fuse_block(DecodedBlock& block);
+    template <Quirks Q>
+    uint32_t run_block(const DecodedBlock& block, uint32_t cycles); // Returns cycles used
+    void invalidate_blocks();   // Drop blocks touched by RAM writes
+
+    // Superinstructions: common opcode sequences the block decoder fuses
+    //  into one micro-op. Handlers apply every part (PC included) and
+    //  return how many instructions retired, which is less than the form
+    //  length when a skip jumps over the trailing instruction.
+    using FusedHandler = uint8_t (CPU::*)(const MicroOp& op);
+    struct FusedInfo {
+        std::array<uint16_t, 3> patterns{};
+        std::array<uint16_t, 3> masks{};
+        uint8_t length = 0;
+        FusedHandler handler = nullptr;
+        const char* name = nullptr;
+    };
+
+    template <Quirks Q>
+    uint8_t fused_annn_dxyn(const MicroOp& op);       // Set I, then draw
+    uint8_t fused_6xnn_6xnn(const MicroOp& op);       // Set two registers
+    uint8_t fused_7xnn_3xnn_1nnn(const MicroOp& op);  // Counting loop
+    uint8_t fused_fx07_3x00_1nnn(const MicroOp& op);  // Delay timer polling
+
+    template <Quirks Q>
+    static constexpr std::array<FusedInfo, FUSED_FORM_COUNT> fused_table_ = {{
+        /*
+         Patterns                  Masks                     Len Handler
+        */
+        {{0xa000, 0xd000, 0x0000}, {0xF000, 0xF000, 0x0000}, 2, &CPU::fused_annn_dxyn<Q>,   "annn_dxyn"},
+        {{0x6000, 0x6000, 0x0000}, {0xF000, 0xF000, 0x0000}, 2, &CPU::fused_6xnn_6xnn,      "6xnn_6xnn"},
+        {{0x7000, 0x3000, 0x1000}, {0xF000, 0xF000, 0xF000}, 3, &CPU::fused_7xnn_3xnn_1nnn, "7xnn_3xnn_1nnn"},
+        {{0xf007, 0x3000, 0x1000}, {0xF0FF, 0xF0FF, 0xF000}, 3, &CPU::fused_fx07_3x00_1nnn, "fx07_3x00_1nnn"},
+    }};
+    static constexpr const std::array<FusedInfo, FUSED_FORM_COUNT>& fused_forms_ = fused_table_<profile_quirks(Profile::Modern)>;
+    static constexpr uint8_t FUSED_INDEX_BASE = INVALID_OPCODE + 1;
+    std::array<uint64_t, FUSED_FORM_COUNT> fused_counts_{};
+
+    // JIT: blocks are compiled once they have run JIT_HOT_THRESHOLD times.
+    //  Everything the JIT can't translate goes through jit_callback.
+    static constexpr uint32_t JIT_HOT_THRESHOLD = 8;
+    std::unique_ptr<JIT> jit_;  // Created on first use
+    std::exception_ptr jit_exception_;  // Raised by a callback, rethrown outside generated code
+    template <Quirks Q>
+    void compile_block(DecodedBlock& block);
+
+    template <Quirks Q, uint8_t Index>
+    static bool jit_callback(CPU* cpu, uint16_t opcode);
+
+    // AOT: the compiled program for the loaded ROM, if one was built in
+    const AotProgram* aot_program_ = nullptr;
+    bool aot_code_modified_ = false;    // Translated code was overwritten at some point
+    bool check_aot_code_writes();
+    void mark_aot_code();   // Flag the program's translated ranges in the code map
+    static std::vector<const AotProgram*>& aot_registry();
 
 };
\ No newline at end of file
@@ -1,73 +1,460 @@
 #include "emulator.h"
+#include "guest_profiler.h"
+#include "movie.h"
+#include "rewind.h"
+#include "save_state.h"
 #include "utilities.h"
 #include "print.h"
 
 #include <string>
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <stdexcept>
+#include <thread>
 
-Emulator::Emulator() 
-    : cpu_(peripherals_, ram_, delay_timer_, sound_timer_) {}
+Emulator::Emulator(std::unique_ptr<Backend> backend)
+    : peripherals_(std::move(backend)),
+      cpu_(peripherals_, ram_, delay_timer_, sound_timer_),
+      telemetry_(peripherals_.backend().tick_frequency()) {
+    peripherals_.backend().set_telemetry(&telemetry_);
+}
+
+Emulator::~Emulator() = default;
 
 
 void Emulator::load_rom(const std::string& rom_filepath, int start_address) {
 
-    ram_.load_file(rom_filepath, start_address);
+    uint16_t rom_size = ram_.load_file(rom_filepath, start_address);
+
+    // Pick up an ahead-of-time compiled version of the program, if built in
+    if (start_address == Utils::PROGRAM_START_ADDRESS) {
+        cpu_.load_aot_program(start_address, rom_size);
+        if (profiler_)
+            profiler_->set_rom(start_address, rom_size);
+    }
+}
+
+void Emulator::set_guest_profiler(GuestProfiler* profiler) {
+    profiler_ = profiler;
+    cpu_.set_profiler(profiler);
+}
+
+
+void Emulator::save_state(SaveState& state) const {
+    state.header = SaveState::Header{};
+    state.header.size = sizeof(SaveState);
+    state.header.profile = cpu_.profile();
+    state.frame = frame_;
+    state.cycles = cycles_;
+    state.timer_ticks = timer_clock_.now();
+    state.delay_timer = delay_timer_.get();
+    state.sound_timer = sound_timer_.get();
+    cpu_.save(state.cpu);
+    peripherals_.save(state.peripherals);
+    state.ram = ram_.contents();
+}
+
+void Emulator::load_state(const SaveState& state) {
+    if (!state.valid())
+        throw std::runtime_error("Save state is from another version or build");
+
+    cpu_.set_profile(state.header.profile);
+    frame_ = state.frame;
+    cycles_ = state.cycles;
+
+    // Timers count from the clock, so put it back before setting them
+    timer_clock_.restore(state.timer_ticks);
+    delay_timer_.set(state.delay_timer);
+    sound_timer_.set(state.sound_timer);
+
+    cpu_.load(state.cpu);
+    peripherals_.load(state.peripherals);
+    ram_.restore(state.ram);
+
+    // The profiler follows the restored call stack from here. Each stack
+    //  entry is the address of the 2nnn that made the call.
+    if (profiler_) {
+        std::array<uint16_t, Utils::STACK_DEPTH> targets;
+        for (size_t idx = 0; idx < state.cpu.sp; idx++) {
+            uint32_t call = state.cpu.stack[idx] & (Utils::MEMORY_SIZE - 1);
+            targets[idx] = static_cast<uint16_t>((state.ram[call] << 8 | state.ram[(call + 1) & (Utils::MEMORY_SIZE - 1)]) & 0x0FFF);
+        }
+        profiler_->set_stack(targets.data(), state.cpu.sp);
+    }
+
+    // Show the restored screen at the end of the next frame
+    cpu_.draw_flag = true;
+}
+
+void Emulator::set_rewind(uint32_t seconds) {
+    if (seconds == 0) {
+        rewind_.reset();
+        return;
+    }
+    rewind_ = std::make_unique<Rewind>(static_cast<size_t>(seconds) * Utils::TIMER_CYCLE_HZ);
+}
+
+bool Emulator::rewind_frame() {
+    const SaveState* state = rewind_->step_back();
+    if (!state)
+        return false;
+    load_state(*state);
+    peripherals_.rewound(frame_);
+
+    // Show it now, and keep quiet while going backwards
+    peripherals_.render_display();
+    cpu_.draw_flag = false;
+    peripherals_.beep(frame_ + 1, false);
+    return true;
 }
 
+void Emulator::set_run_ahead(uint32_t frames) {
+    run_ahead_ = frames;
+    if (frames != 0 && !run_ahead_state_)
+        run_ahead_state_ = std::make_unique<SaveState>();
+}
+
+void Emulator::run_ahead_frame(uint64_t max_cycles) {
+    // The real frame is heard as usual, but its screen is never shown
+    hold_display_ = true;
+    run_frame(max_cycles);
+    if (limit_reached(0, max_cycles)) {
+        hold_display_ = false;
+        if (cpu_.draw_flag)
+            peripherals_.render_display();
+        cpu_.draw_flag = false;
+        return;
+    }
+
+    // The frames ahead see the same input, silently, and only the last
+    //  one reaches the screen. None of it is kept: rewind only captures
+    //  real frames, the guest profiler is detached, and the backend never
+    //  hears of the rest.
+    save_state(*run_ahead_state_);
+    bool audio_changed = peripherals_.audio_changed;
+    muted_ = true;
+    cpu_.set_profiler(nullptr);
+    for (uint32_t ahead = 0; ahead < run_ahead_ && !ram_.faulted() && !cpu_.exited(); ahead++) {
+        cpu_.run(cycles_per_frame_);
+        end_frame();
+    }
+    muted_ = false;
+    hold_display_ = false;
+    if (cpu_.draw_flag)
+        peripherals_.render_display();
+
+    // Back to the real frame. What's on screen already covers everything
+    //  it drew, and a bad access ahead is raised again when it's reached.
+    load_state(*run_ahead_state_);
+    cpu_.set_profiler(profiler_);
+    cpu_.draw_flag = false;
+    peripherals_.audio_changed = audio_changed;
+    ram_.clear_fault();
+}
+
+void Emulator::record_movie(Movie& movie, const std::string& rom_filepath) {
+    movie.profile = cpu_.profile();
+    movie.cycles_per_frame = cycles_per_frame_;
+    movie.rom_hash = Movie::hash_rom(rom_filepath);
+    cpu_.seed(movie.seed);
+    recording_ = &movie;
+    peripherals_.record(&movie);
+}
+
+void Emulator::play_movie(const Movie& movie, const std::string& rom_filepath) {
+    if (Movie::hash_rom(rom_filepath) != movie.rom_hash)
+        throw std::runtime_error("Movie was recorded with another ROM");
+
+    cpu_.set_profile(movie.profile);
+    cycles_per_frame_ = movie.cycles_per_frame;
+    cpu_.seed(movie.seed);
+    peripherals_.play(&movie);
+}
 
-void Emulator::run() {
+void Emulator::run(uint64_t max_frames, uint64_t max_cycles) {
     PRINT_DEBUG("Emulation started!");
 
-    // Set up how often we need to service CPU and Display Cycles
-    uint64_t cpu_cycle_ticks = SDL_GetPerformanceFrequency() / Utils::CPU_CYCLE_HZ;
-    uint64_t timer_cycle_ticks = SDL_GetPerformanceFrequency() / Utils::TIMER_CYCLE_HZ;
-    uint64_t last_timer_tick = SDL_GetPerformanceCounter();
+    Backend& backend = peripherals_.backend();
+    if (backend.runs_ui()) {
+        // The host's UI keeps this thread; emulation gets its own so
+        //  drawing and event handling never hold up instructions
+        std::atomic<bool> finished{false};
+        std::exception_ptr error;
+        std::thread emulation([&] {
+            try {
+                run_loop(max_frames, max_cycles);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            finished.store(true, std::memory_order_release);
+        });
+        backend.run_ui(finished);
+        emulation.join();
+        if (error)
+            std::rethrow_exception(error);
+    } else {
+        run_loop(max_frames, max_cycles);
+    }
+
+    if (recording_)
+        recording_->frames = frame_;
+
+    if (ram_.faulted())
+        PRINT_DEBUG("Stopped on a memory access out of range: %04x", ram_.fault_address());
+
+    PRINT_DEBUG("Idle cycles skipped: %llu", static_cast<unsigned long long>(idle_cycles()));
+
+    for (size_t timing = 0; timing < Telemetry::TIMING_COUNT; timing++) {
+        const Histogram& histogram = telemetry_.histogram(static_cast<Telemetry::Timing>(timing));
+        PRINT_DEBUG("Frame %s: %.3f ms p50, %.3f ms p99, %.3f ms max", Telemetry::timing_name(static_cast<Telemetry::Timing>(timing)),
+            histogram.percentile(0.5) / 1e6, histogram.percentile(0.99) / 1e6, histogram.max() / 1e6);
+    }
+    PRINT_DEBUG("Late frames: %llu, dropped presents: %llu", static_cast<unsigned long long>(telemetry_.late_frames()),
+        static_cast<unsigned long long>(telemetry_.dropped_presents()));
+
+    // Report how often each superinstruction fired (cached engine)
+    for (size_t form = 0; form < CPU::FUSED_FORM_COUNT; form++) {
+        PRINT_DEBUG("Fused %s: %llu", CPU::fused_form_name(form), static_cast<unsigned long long>(cpu_.fused_count(form)));
+    }
+}
+
+void Emulator::run_loop(uint64_t max_frames, uint64_t max_cycles) {
+    if (peripherals_.backend().real_time()) {
+        run_real_time(max_frames, max_cycles);
+    } else {
+        run_unthrottled(max_frames, max_cycles);
+    }
+}
+
+void Emulator::run_real_time(uint64_t max_frames, uint64_t max_cycles) {
+    Backend& backend = peripherals_.backend();
 
-    while (true) {
-        
-        uint64_t start_tick = SDL_GetPerformanceCounter();
+    // Frames are paced against an absolute schedule (start tick + N frame
+    //  periods) rather than by sleeping a fixed amount, so small oversleeps
+    //  don't pile up over a long run
+    uint64_t pace_start = backend.ticks();
+    uint64_t pace_frames = 0;
 
-        // Handle events that happen at CPU cycle frequency
-        if (peripherals_.process_input())
+    while (!limit_reached(max_frames, max_cycles)) {
+        // Input once per frame is plenty: the CPU only sees it between frames
+        if (peripherals_.process_input(frame_))
             break;
-    
-        cpu_.cycle();
 
+        Speed requested;
+        if (backend.take_speed_request(requested) && requested != speed_) {
+            speed_ = requested;
+            pace_start = backend.ticks();
+            pace_frames = 0;
+        }
+
+        // While the rewind key is held, frames go backwards at the same
+        //  pace instead of running, and stop at the oldest one kept
+        uint64_t frame_start = backend.ticks();
+        if (rewind_ && backend.rewind_held()) {
+            rewind_frame();
+        } else if (run_ahead_ != 0 && speed_ != Speed::Unthrottled) {
+            run_ahead_frame(max_cycles);
+        } else {
+            run_frame(max_cycles);
+        }
+        telemetry_.record(Telemetry::Timing::Emulation, backend.ticks() - frame_start);
+
+        if (speed_ == Speed::Unthrottled) {
+            telemetry_.frame(false);
+            pace_start = backend.ticks();
+            pace_frames = 0;
+            continue;
+        }
+
+        // Following the audio clock: the host clock still paces each frame,
+        //  but the schedule slides a little whenever the audio queue runs
+        //  fuller or emptier than it should
+        if (sync_ == Sync::Audio && speed_ == Speed::Normal)
+            pace_start = static_cast<uint64_t>(static_cast<int64_t>(pace_start) + audio_rate_correction());
+
+        uint64_t deadline = frame_deadline(pace_start, ++pace_frames);
+        uint64_t now = backend.ticks();
+        telemetry_.frame(now > deadline);
+
+        // Too far behind to catch up (host stalled, window dragged, ...):
+        //  start a new schedule instead of running frames back-to-back
+        if (now > deadline + backend.tick_frequency() / 4) {
+            PRINT_DEBUG("Frame pacing fell behind, resyncing");
+            pace_start = now;
+            pace_frames = 0;
+            continue;
+        }
+
+        uint64_t ticks_per_ms = backend.tick_frequency() / 1000;
+
+        // An idle program can't change anything before the next frame, so
+        //  block without spinning. A key press ends an Fx0A wait right away
+        //  rather than at the next frame boundary.
+        CPU::Idle idle = cpu_.idle();
+        if (idle != CPU::Idle::None) {
+            if (now < deadline) {
+                uint32_t ms = static_cast<uint32_t>((deadline - now + ticks_per_ms - 1) / ticks_per_ms);
+                if (idle != CPU::Idle::Key) {
+                    backend.delay(ms);
+                    record_overshoot(deadline);
+                } else if (backend.wait_input(ms)) {
+                    pace_start = backend.ticks();
+                    pace_frames = 0;
+                } else {
+                    record_overshoot(deadline);
+                }
+            }
+            continue;
+        }
 
-        // Handle events that happen at timer cycle frequency
-        if (start_tick - last_timer_tick >= timer_cycle_ticks) {
-            PRINT_DEBUG("FPS: %f", SDL_GetPerformanceFrequency()/static_cast<float>(start_tick - last_timer_tick) );
-            // Update the display
-            if (cpu_.draw_flag)
-            {
-                peripherals_.render_display();
-                cpu_.draw_flag = false;
+        // Sleep in whole milliseconds, then spin out the remaining fraction
+        if (now < deadline) {
+            while (now < deadline && deadline - now >= ticks_per_ms) {
+                backend.delay(static_cast<uint32_t>((deadline - now) / ticks_per_ms));
+                now = backend.ticks();
             }
-            
-            // Decrement the timers
-            delay_timer_.tick();
-            sound_timer_.tick();
+            while (backend.ticks() < deadline) {}
+            record_overshoot(deadline);
+        }
+    }
+}
+
+void Emulator::record_overshoot(uint64_t deadline) {
+    uint64_t now = peripherals_.backend().ticks();
+    telemetry_.record(Telemetry::Timing::SleepOvershoot, now > deadline ? now - deadline : 0);
+}
+
+void Emulator::run_unthrottled(uint64_t max_frames, uint64_t max_cycles) {
+    // No clock to follow: a frame is simply a frame's worth of cycles.
+    //  While the program idles, the CPU skips those cycles outright, so
+    //  waits on the delay timer or input cost one check per frame.
+    while (!limit_reached(max_frames, max_cycles)) {
+        if (peripherals_.process_input(frame_))
+            break;
+
+        run_frame(max_cycles);
+        skip_idle_frames(max_frames, max_cycles);
+    }
+}
+
+void Emulator::run_frame(uint64_t max_cycles) {
+    uint64_t frame_cycles = cycles_per_frame_;
+    if (max_cycles != 0)
+        frame_cycles = std::min(frame_cycles, max_cycles - cycles_);
 
-            // Make the buzzer beep if the sound timer is not timed-out
-            peripherals_.beep(!sound_timer_.in_timeout());
+    cpu_.run(frame_cycles);
+    cycles_ += frame_cycles;
 
-            // Update the last timer tick
-            last_timer_tick = start_tick;
+    // A cycle budget can stop mid-frame
+    if (frame_cycles == cycles_per_frame_) {
+        end_frame();
+        if (rewind_) {
+            save_state(rewind_->next());
+            rewind_->capture();
         }
+    }
+}
+
+void Emulator::skip_idle_frames(uint64_t max_frames, uint64_t max_cycles) {
+    // A halted program, or one waiting in Fx0A, does nothing at all until
+    //  input arrives, so its frames can be skipped wholesale
+    CPU::Idle idle = cpu_.idle();
+    if ((idle != CPU::Idle::Halted && idle != CPU::Idle::Key) || cpu_.draw_flag || cycles_per_frame_ == 0 || ram_.faulted())
+        return;
 
-        uint64_t elapsed_ticks = SDL_GetPerformanceCounter() - start_tick;
+    // Stop short of anything that would make a frame differ: scripted
+    //  input, the end of the run, and the beeper switching off
+    uint64_t until = peripherals_.next_input_frame();
+    if (max_frames != 0)
+        until = std::min(until, max_frames);
+    if (max_cycles != 0)
+        until = std::min(until, frame_ + (max_cycles - cycles_) / cycles_per_frame_);
+    if (!sound_timer_.in_timeout())
+        until = std::min(until, frame_ + sound_timer_.ticks_until_expiry() - 1);
+    if (until <= frame_)
+        return;
 
-        // Let the host rest if we're ahead
-        if (elapsed_ticks < cpu_cycle_ticks) {
+    uint64_t frames = until - frame_;
+    timer_clock_.advance(frames);
+    cycles_ += frames * cycles_per_frame_;
+    skipped_cycles_ += frames * cycles_per_frame_;
+    skipped_frames_ += frames;
+    frame_ += frames;
+}
 
-            // Check how many ms we can possibly wait by converting ticks to next cpu cyle into ms
-            float ms_to_wait = (cpu_cycle_ticks - elapsed_ticks) * 1000.0f / SDL_GetPerformanceFrequency();
+uint64_t Emulator::frame_deadline(uint64_t start_tick, uint64_t frames) const {
+    uint64_t frequency = peripherals_.backend().tick_frequency();
 
-            // If we are able to take a break greater than our smallest rest resolution (1ms), take it
-            if (ms_to_wait >= 1.0) {
-                SDL_Delay(static_cast<uint32_t>(std::min(ms_to_wait, 2.0f)));
-            }
-        } 
+    // Frame period in ticks is frequency / 60 scaled by the speed; working
+    //  from the frame count keeps the rounding from accumulating
+    uint64_t rate = Utils::TIMER_CYCLE_HZ;
+    switch (speed_) {
+        case Speed::Double:     rate *= 2; break;
+        case Speed::SlowMotion: frequency *= 2; break;
+        default: break;
+    }
+    return start_tick + frames * frequency / rate;
+}
+
+int64_t Emulator::audio_rate_correction() {
+    Backend& backend = peripherals_.backend();
+    int64_t lead = 0;
+    if (!backend.audio_lead(frame_, lead))
+        return 0;
+
+    // The device takes a whole buffer at a time, so the lead saws between
+    //  empty and one buffer; average it and aim for the middle
+    if (!audio_lead_valid_) {
+        audio_lead_avg_ = static_cast<double>(lead);
+        audio_lead_valid_ = true;
     }
+    audio_lead_avg_ += (lead - audio_lead_avg_) / AUDIO_LEAD_SMOOTHING;
 
-}
\ No newline at end of file
+    // Running ahead of the device stretches the frame period, falling
+    //  behind shortens it. The slowly accumulated trim takes up the clocks'
+    //  steady rate difference so the lead settles on the target itself.
+    double target = Utils::AUDIO_BUFFER_SIZE / 2.0;
+    double error = std::clamp((audio_lead_avg_ - target) / target, -1.0, 1.0);
+    audio_rate_trim_ = std::clamp(audio_rate_trim_ + error / AUDIO_RATE_SETTLE, -1.0, 1.0);
+    double adjust = std::clamp(error + audio_rate_trim_, -1.0, 1.0);
+    double frame_ticks = static_cast<double>(backend.tick_frequency()) / Utils::TIMER_CYCLE_HZ;
+    return std::llround(frame_ticks * MAX_AUDIO_RATE_ADJUST * adjust);
+}
+
+bool Emulator::limit_reached(uint64_t max_frames, uint64_t max_cycles) const {
+    // A trapping memory bus stops the run at its first bad access, and
+    //  SUPER-CHIP programs can exit with 00FD
+    return (max_frames != 0 && frame_ >= max_frames) || (max_cycles != 0 && cycles_ >= max_cycles) ||
+        ram_.faulted() || cpu_.exited();
+}
+
+void Emulator::end_frame() {
+    // Update the display. While it's held, the flag stays up so the
+    //  frame that does present knows something was drawn.
+    if (cpu_.draw_flag && !hold_display_)
+    {
+        peripherals_.render_display();
+        cpu_.draw_flag = false;
+    }
+    
+    // Both timers count down from the shared clock
+    timer_clock_.advance();
+    cpu_.vblank();
+
+    if (muted_) {
+        frame_++;
+        return;
+    }
+
+    // Make the buzzer beep if the sound timer is not timed-out, from the
+    //  start of the next frame
+    peripherals_.beep(frame_ + 1, !sound_timer_.in_timeout());
+    if (peripherals_.audio_changed) {
+        peripherals_.audio_pattern(frame_ + 1, peripherals_.audio_buffer, peripherals_.audio_pitch);
+        peripherals_.audio_changed = false;
+    }
+
+    frame_++;
+}
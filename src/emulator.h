@@ -1,24 +1,125 @@
 #pragma once
 
+#include <memory>
 #include <string>
 #include "peripherals.h"
 #include "ram.h"
 #include "cpu.h"
 #include "utilities.h"
+#include "telemetry.h"
 #include "timer.h"
 
+struct SaveState;
+class Rewind;
+class Movie;
+class GuestProfiler;
+
+// Clock that real-time runs are paced against
+enum class Sync {
+    Clock,  // The host's performance counter
+    Audio,  // The audio device's sample rate, so sound and frames never drift apart
+};
 
 class Emulator {
     public:
-        Emulator();
+        explicit Emulator(std::unique_ptr<Backend> backend);
+        ~Emulator();
 
         void load_rom(const std::string& rom_filepath, int start_address=Utils::PROGRAM_START_ADDRESS);
-        void run();
+        // Runs until quit, or until either limit is reached (0 = no limit)
+        void run(uint64_t max_frames = 0, uint64_t max_cycles = 0);
+        void set_cpu_engine(CPU::Engine engine) { cpu_.set_engine(engine); }
+        void set_profile(Profile profile) { cpu_.set_profile(profile); }
+        void seed(uint32_t seed) { cpu_.seed(seed); }
+
+        // Pacing: instructions per 60 Hz frame, and how fast frames go by
+        //  on real-time backends. Both can change while running.
+        void set_cycles_per_frame(uint32_t cycles) { cycles_per_frame_ = cycles; }
+        void set_speed(Speed speed) { speed_ = speed; }
+        Speed speed() const { return speed_; }
+        void set_sync(Sync sync) { sync_ = sync; }
+
+        // Save states (see save_state.h). Loading throws std::runtime_error
+        //  for a state from another version or build.
+        void save_state(SaveState& state) const;
+        void load_state(const SaveState& state);
+
+        // Rewind: keep the last `seconds` of frames so holding the
+        //  backend's rewind key steps back through them (0 = off)
+        void set_rewind(uint32_t seconds);
+
+        // Run-ahead: each frame on real-time backends, run `frames` more
+        //  on the input just read, show the last of them and go back, so
+        //  input shows up that many frames sooner (0 = off)
+        void set_run_ahead(uint32_t frames);
+
+        // Movies (see movie.h). Recording fills in the movie's settings
+        //  and events as the run goes; playback applies its settings and
+        //  replaces the backend's input with its events. Both start from
+        //  reset, and the movie must outlive the run.
+        void record_movie(Movie& movie, const std::string& rom_filepath);
+        void play_movie(const Movie& movie, const std::string& rom_filepath);   // Throws std::runtime_error
+
+        // Guest profiling (see guest_profiler.h): attach before loading the
+        //  ROM so its coverage map covers the program image
+        void set_guest_profiler(GuestProfiler* profiler);
+
+        // Host-side frame timing of real-time runs (see telemetry.h), and
+        //  a Prometheus text file of it rewritten every interval
+        const Telemetry& telemetry() const { return telemetry_; }
+        void export_stats(const std::string& path, uint32_t interval_seconds) { telemetry_.start_export(path, interval_seconds); }
+
+        const Peripherals& peripherals() const { return peripherals_; }
+        uint64_t frame() const { return frame_; }
+        uint64_t cycles() const { return cycles_; }
+        uint64_t idle_cycles() const { return cpu_.idle_cycles() + skipped_cycles_; }  // Part of cycles() skipped, not run
+        uint64_t skipped_frames() const { return skipped_frames_; }    // Part of frame() skipped outright
     
     private:
         Peripherals peripherals_;
         RAM ram_;
-        Timer delay_timer_;
-        Timer sound_timer_;
+        TimerClock timer_clock_;
+        Timer delay_timer_{timer_clock_};
+        Timer sound_timer_{timer_clock_};
         CPU cpu_;    
+        Telemetry telemetry_;
+
+        uint64_t frame_ = 0;    // 60 Hz frames completed
+        uint64_t cycles_ = 0;   // CPU instructions executed
+        uint64_t skipped_frames_ = 0;   // Whole frames skipped while idle, and their cycles
+        uint64_t skipped_cycles_ = 0;
+
+        uint32_t cycles_per_frame_ = Utils::CYCLES_PER_FRAME;
+        Speed speed_ = Speed::Normal;
+        Sync sync_ = Sync::Clock;
+
+        // Audio sync: the frame schedule is nudged by up to this fraction
+        //  of a frame to keep the queued audio near its target
+        static constexpr double MAX_AUDIO_RATE_ADJUST = 0.005;
+        static constexpr double AUDIO_LEAD_SMOOTHING = 32.0;   // Frames averaged over
+        static constexpr double AUDIO_RATE_SETTLE = 600.0;     // Frames to trim out a steady offset
+        double audio_lead_avg_ = 0.0;
+        double audio_rate_trim_ = 0.0;  // Accumulated error: the clocks' steady rate difference
+        bool audio_lead_valid_ = false;
+
+        std::unique_ptr<Rewind> rewind_;
+        uint32_t run_ahead_ = 0;
+        std::unique_ptr<SaveState> run_ahead_state_;   // The real frame, while running ahead of it
+        bool hold_display_ = false;     // Frames end without presenting (the screen waits for the frames ahead)
+        bool muted_ = false;            // Frames end without sound (running ahead)
+        Movie* recording_ = nullptr;
+        GuestProfiler* profiler_ = nullptr;
+
+        void run_loop(uint64_t max_frames, uint64_t max_cycles);        // Emulation thread body
+        void run_real_time(uint64_t max_frames, uint64_t max_cycles);   // Throttled to the backend's clock
+        void run_unthrottled(uint64_t max_frames, uint64_t max_cycles); // As fast as the host allows
+        bool limit_reached(uint64_t max_frames, uint64_t max_cycles) const;
+        void run_frame(uint64_t max_cycles);   // One frame's budget of cycles, then end_frame()
+        uint64_t frame_deadline(uint64_t start_tick, uint64_t frames) const;
+        int64_t audio_rate_correction();    // Ticks to shift the frame schedule by
+        void record_overshoot(uint64_t deadline);   // How late a pacing wait woke up
+        void skip_idle_frames(uint64_t max_frames, uint64_t max_cycles);    // Headless fast-forward
+        bool rewind_frame();    // Step back one frame and show it, false at the oldest
+        void run_ahead_frame(uint64_t max_cycles); // run_frame(), then show where it leads
+        void end_frame();   // Render, tick timers and update the beeper
 };
\ No newline at end of file
@@ -0,0 +1,101 @@
+#include "framebuffer.h"
+
+#include <cstring>
+
+void Framebuffer::set_hires(bool hires) {
+    hires_ = hires;
+    clear((1u << PLANES) - 1);
+}
+
+bool Framebuffer::lores_single_plane() const {
+    if (hires_)
+        return false;
+    for (size_t plane = 1; plane < PLANES; plane++) {
+        for (const Row& row : planes_[plane]) {
+            if (row[0] | row[1])
+                return false;
+        }
+    }
+    return true;
+}
+
+uint8_t Framebuffer::pixel(uint16_t x, uint16_t y) const {
+    uint8_t color = 0;
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        color |= plane_pixel(plane, x, y) << plane;
+    }
+    return color;
+}
+
+void Framebuffer::to_rgba(void* pixels, int pitch) const {
+    uint16_t scale = hires_ ? 1 : 2;
+    for (uint16_t y = 0; y < Utils::HIRES_HEIGHT; y++) {
+        uint32_t* row = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + y * pitch);
+        for (uint16_t x = 0; x < Utils::HIRES_WIDTH; x++) {
+            row[x] = Utils::PALETTE[pixel(x / scale, y / scale)];
+        }
+    }
+}
+
+void Framebuffer::clear(uint8_t mask) {
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        if (mask >> plane & 0x1)
+            planes_[plane] = {};
+    }
+}
+
+/*
+    Scrolling: whole rows move with memmove, sideways scrolls shift each
+    row's words and carry the bits that cross between them
+*/
+void Framebuffer::scroll_down(uint8_t rows, uint8_t mask) {
+    size_t count = std::min<size_t>(rows, height());
+    size_t kept = height() - count;
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        if (!(mask >> plane & 0x1))
+            continue;
+        Plane& target = planes_[plane];
+        std::memmove(&target[count], &target[0], kept * sizeof(Row));
+        std::memset(&target[0], 0, count * sizeof(Row));
+    }
+}
+
+void Framebuffer::scroll_up(uint8_t rows, uint8_t mask) {
+    size_t count = std::min<size_t>(rows, height());
+    size_t kept = height() - count;
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        if (!(mask >> plane & 0x1))
+            continue;
+        Plane& target = planes_[plane];
+        std::memmove(&target[0], &target[count], kept * sizeof(Row));
+        std::memset(&target[kept], 0, count * sizeof(Row));
+    }
+}
+
+void Framebuffer::scroll_right(uint8_t mask) {
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        if (!(mask >> plane & 0x1))
+            continue;
+        for (size_t y = 0; y < height(); y++) {
+            Row& row = planes_[plane][y];
+            if (hires_)
+                row[1] = row[1] >> 4 | row[0] << 60;
+            row[0] >>= 4;
+        }
+    }
+}
+
+void Framebuffer::scroll_left(uint8_t mask) {
+    for (size_t plane = 0; plane < PLANES; plane++) {
+        if (!(mask >> plane & 0x1))
+            continue;
+        for (size_t y = 0; y < height(); y++) {
+            Row& row = planes_[plane][y];
+            row[0] <<= 4;
+            if (hires_) {
+                row[0] |= row[1] >> 60;
+                row[1] <<= 4;
+            }
+        }
+    }
+}
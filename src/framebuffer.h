@@ -0,0 +1,96 @@
+#pragma once
+
+#include "utilities.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+// The screen in every mode: 64x32 lores, 128x64 hires (SUPER-CHIP) and up
+//  to four bitplanes (XO-CHIP). Each plane is packed one bit per pixel,
+//  two words per row with the MSB as the leftmost pixel, so a sprite row
+//  is a shift and XOR per word and scrolling is word shifts and memmove.
+//  Lores only uses the first word of the top 32 rows.
+class Framebuffer {
+    public:
+        static constexpr size_t PLANES = 4;
+        static constexpr size_t ROWS = Utils::HIRES_HEIGHT;
+        static constexpr size_t WORDS = Utils::HIRES_WIDTH / 64;
+        using Row = std::array<uint64_t, WORDS>;
+        using Plane = std::array<Row, ROWS>;
+
+        bool hires() const { return hires_; }
+        uint16_t width() const { return hires_ ? Utils::HIRES_WIDTH : Utils::PIXEL_WIDTH; }
+        uint16_t height() const { return hires_ ? Utils::HIRES_HEIGHT : Utils::PIXEL_HEIGHT; }
+        void set_hires(bool hires);     // Switch resolution, which clears every plane
+
+        // True for a 64x32 screen drawn on the first plane only, as on the
+        //  original CHIP-8
+        bool lores_single_plane() const;
+
+        Row& row(size_t plane, uint16_t y) { return planes_[plane][y]; }
+        const Row& row(size_t plane, uint16_t y) const { return planes_[plane][y]; }
+        bool plane_pixel(size_t plane, uint16_t x, uint16_t y) const {
+            return (planes_[plane][y][x / 64] >> (63 - x % 64)) & 0x1;
+        }
+        uint8_t pixel(uint16_t x, uint16_t y) const;    // Color index, one bit per plane
+
+        // Expand to 128x64 RGBA8888 through the palette, lores pixels drawn
+        //  2x2; `pitch` is the bytes from one output row to the next
+        void to_rgba(void* pixels, int pitch) const;
+
+        // Operations on the planes selected by mask (bit n = plane n)
+        void clear(uint8_t mask);
+        void scroll_down(uint8_t rows, uint8_t mask);
+        void scroll_up(uint8_t rows, uint8_t mask);
+        void scroll_right(uint8_t mask);    // 4 pixels
+        void scroll_left(uint8_t mask);     // 4 pixels
+
+        // XOR a sprite onto one plane: `rows` bytes, or 16-bit rows when
+        //  wide. The start position wraps around the screen; the rest of
+        //  the sprite is clipped at the edges, or wraps too without Clip.
+        //  Returns true if any lit pixel was turned off.
+        template <bool Clip>
+        bool draw(size_t plane, uint16_t x, uint16_t y, const uint8_t* sprite, uint8_t rows, bool wide) {
+            const uint16_t height_mask = height() - 1;
+            const size_t words = hires_ ? WORDS : 1;
+            x %= width();
+            y &= height_mask;
+            if constexpr (Clip)
+                rows = std::min<uint16_t>(rows, height() - y);
+
+            const size_t word = x / 64;
+            const unsigned shift = x % 64;
+            const unsigned sprite_bits = wide ? 16 : 8;
+
+            bool collision = false;
+            for (uint8_t row_idx = 0; row_idx < rows; row_idx++) {
+                uint64_t bits = wide ? (sprite[2 * row_idx] << 8 | sprite[2 * row_idx + 1]) : sprite[row_idx];
+                bits <<= 64 - sprite_bits;
+                Row& row = planes_[plane][(y + row_idx) & height_mask];
+
+                uint64_t head = bits >> shift;
+                collision |= (row[word] & head) != 0;
+                row[word] ^= head;
+
+                // The rest runs into the next word, or past the right edge
+                if (shift > 64 - sprite_bits) {
+                    size_t next = word + 1;
+                    if (next == words) {
+                        if constexpr (Clip)
+                            continue;
+                        next = 0;
+                    }
+                    uint64_t tail = bits << (64 - shift);
+                    collision |= (row[next] & tail) != 0;
+                    row[next] ^= tail;
+                }
+            }
+            return collision;
+        }
+
+        bool operator==(const Framebuffer&) const = default;
+
+    private:
+        std::array<Plane, PLANES> planes_{};
+        bool hires_ = false;
+};
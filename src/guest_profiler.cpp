@@ -0,0 +1,172 @@
+#include "guest_profiler.h"
+#include "cpu.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+    std::string hex(uint32_t value, int digits) {
+        char buffer[16];
+        std::snprintf(buffer, sizeof(buffer), "0x%0*x", digits, value);
+        return buffer;
+    }
+
+    // Name for a mix of coverage bits, in the ROM map
+    const char* coverage_kind(uint8_t bits) {
+        switch (bits) {
+            case 0x0: return "untouched";
+            case 0x1: return "code";
+            case 0x2: return "data";
+            case 0x3: return "code+data";
+            case 0x4: return "written";
+            case 0x5: return "code+written";
+            case 0x6: return "data+written";
+            default:  return "code+data+written";
+        }
+    }
+}
+
+GuestProfiler::GuestProfiler()
+    : pc_counts_(Utils::MEMORY_SIZE),
+      coverage_(Utils::MEMORY_SIZE) {
+    nodes_.push_back(Node{0, Utils::PROGRAM_START_ADDRESS, 0});
+}
+
+void GuestProfiler::set_rom(uint32_t start, uint32_t size) {
+    rom_start_ = start;
+    rom_size_ = std::min(size, Utils::MEMORY_SIZE - std::min(start, Utils::MEMORY_SIZE));
+    nodes_[0].address = static_cast<uint16_t>(start);
+}
+
+void GuestProfiler::call(uint16_t target) {
+    uint64_t key = static_cast<uint64_t>(node_) << 16 | target;
+    auto [child, added] = children_.try_emplace(key, static_cast<uint32_t>(nodes_.size()));
+    if (added) {
+        uint16_t depth = static_cast<uint16_t>(nodes_[node_].depth + 1);
+        nodes_.push_back(Node{node_, target, depth});
+        max_depth_ = std::max(max_depth_, depth);
+    }
+    node_ = child->second;
+}
+
+void GuestProfiler::ret() {
+    // A return with nothing on the stack (a program that jumped into a
+    //  subroutine) stays at the top level
+    node_ = nodes_[node_].parent;
+}
+
+void GuestProfiler::set_stack(const uint16_t* targets, size_t depth) {
+    node_ = 0;
+    for (size_t idx = 0; idx < depth; idx++)
+        call(targets[idx]);
+}
+
+void GuestProfiler::write(const std::string& path) const {
+    write_json(path + ".json");
+    write_folded(path + ".folded");
+}
+
+std::string GuestProfiler::stack_name(uint32_t node) const {
+    std::vector<uint32_t> path;
+    for (uint32_t at = node; at != 0; at = nodes_[at].parent)
+        path.push_back(at);
+
+    std::string name = "main";
+    for (auto at = path.rbegin(); at != path.rend(); ++at) {
+        char frame[16];
+        std::snprintf(frame, sizeof(frame), ";sub_%04x", nodes_[*at].address);
+        name += frame;
+    }
+    return name;
+}
+
+void GuestProfiler::write_folded(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open " + path);
+    for (uint32_t node = 0; node < nodes_.size(); node++) {
+        if (nodes_[node].count != 0)
+            out << stack_name(node) << " " << nodes_[node].count << "\n";
+    }
+}
+
+void GuestProfiler::write_json(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open " + path);
+
+    out << "{\n  \"instructions\": " << instructions_ << ",\n  \"max_call_depth\": " << max_depth_ << ",\n";
+
+    // Opcode handlers, busiest first
+    std::vector<uint8_t> handlers;
+    for (size_t handler = 0; handler < handler_counts_.size(); handler++) {
+        if (handler_counts_[handler] != 0)
+            handlers.push_back(static_cast<uint8_t>(handler));
+    }
+    std::stable_sort(handlers.begin(), handlers.end(),
+        [this](uint8_t a, uint8_t b) { return handler_counts_[a] > handler_counts_[b]; });
+    out << "  \"handlers\": [";
+    for (size_t idx = 0; idx < handlers.size(); idx++) {
+        out << (idx ? ",\n" : "\n") << "    {\"opcode\": \"" << CPU::opcode_name(handlers[idx])
+            << "\", \"count\": " << handler_counts_[handlers[idx]] << "}";
+    }
+    out << "\n  ],\n";
+
+    // Instructions per address, busiest first
+    std::vector<uint32_t> pcs;
+    for (uint32_t pc = 0; pc < pc_counts_.size(); pc++) {
+        if (pc_counts_[pc] != 0)
+            pcs.push_back(pc);
+    }
+    std::stable_sort(pcs.begin(), pcs.end(), [this](uint32_t a, uint32_t b) { return pc_counts_[a] > pc_counts_[b]; });
+    out << "  \"addresses\": [";
+    for (size_t idx = 0; idx < pcs.size(); idx++) {
+        out << (idx ? ",\n" : "\n") << "    {\"pc\": \"" << hex(pcs[idx], 4) << "\", \"count\": " << pc_counts_[pcs[idx]] << "}";
+    }
+    out << "\n  ],\n";
+
+    // Instructions at each call depth
+    std::vector<uint64_t> depths(max_depth_ + 1);
+    for (const Node& node : nodes_)
+        depths[node.depth] += node.count;
+    out << "  \"call_depth\": [";
+    for (size_t depth = 0; depth < depths.size(); depth++)
+        out << (depth ? ", " : "") << depths[depth];
+    out << "],\n";
+
+    // ROM coverage: totals, then runs of bytes used the same way
+    std::array<uint32_t, 8> totals = {};
+    for (uint32_t offset = 0; offset < rom_size_; offset++)
+        totals[coverage_[rom_start_ + offset] & 0x7]++;
+    auto count = [&totals](uint8_t bit) {
+        uint32_t sum = 0;
+        for (uint8_t bits = 0; bits < totals.size(); bits++) {
+            if (bits & bit)
+                sum += totals[bits];
+        }
+        return sum;
+    };
+    out << "  \"coverage\": {\"rom_start\": \"" << hex(rom_start_, 4) << "\", \"rom_size\": " << rom_size_
+        << ", \"code_bytes\": " << count(EXECUTED) << ", \"data_read_bytes\": " << count(READ)
+        << ", \"data_written_bytes\": " << count(WRITTEN) << ", \"code_and_data_bytes\": " << totals[EXECUTED | READ] + totals[EXECUTED | READ | WRITTEN]
+        << ", \"untouched_bytes\": " << totals[0] << "},\n";
+
+    out << "  \"rom_map\": [";
+    bool first = true;
+    for (uint32_t start = 0; start < rom_size_;) {
+        uint8_t bits = coverage_[rom_start_ + start] & 0x7;
+        uint32_t end = start + 1;
+        while (end < rom_size_ && (coverage_[rom_start_ + end] & 0x7) == bits)
+            end++;
+        out << (first ? "\n" : ",\n") << "    {\"start\": \"" << hex(rom_start_ + start, 4) << "\", \"end\": \""
+            << hex(rom_start_ + end, 4) << "\", \"kind\": \"" << coverage_kind(bits) << "\"}";
+        first = false;
+        start = end;
+    }
+    out << "\n  ]\n}\n";
+
+    if (!out)
+        throw std::runtime_error("Failed to write " + path);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "utilities.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Where a program spends its time, gathered by the CPU's profiled
+//  interpreter (see CPU::set_profiler) one instruction at a time: counts
+//  per opcode handler and per address, the call stack as 2nnn/00EE build
+//  it, and which bytes were run as code and which were read or written as
+//  data.
+//
+// Call stacks are kept as a tree of call sites, so each instruction only
+//  bumps the count of the node it ran in; the folded-stack file is built
+//  from the tree at the end.
+class GuestProfiler {
+    public:
+        GuestProfiler();
+
+        void set_rom(uint32_t start, uint32_t size);    // The program image, for the coverage map
+
+        // Called before each instruction runs
+        void instruction(uint16_t pc, uint8_t handler, uint8_t length) {
+            handler_counts_[handler]++;
+            pc_counts_[pc & (Utils::MEMORY_SIZE - 1)]++;
+            nodes_[node_].count++;
+            mark(pc, length, EXECUTED);
+            instructions_++;
+        }
+        void call(uint16_t target);
+        void ret();
+        // Start over at this call stack (subroutine entry points, outermost
+        //  first), for when a save state is loaded
+        void set_stack(const uint16_t* targets, size_t depth);
+        void data(uint32_t address, uint32_t length, bool write) { mark(address, length, write ? WRITTEN : READ); }
+
+        // Writes <path>.json (the report) and <path>.folded (one line per
+        //  call stack, "main;sub_0244;sub_02a0 <instructions>", for
+        //  flamegraph tools). Throws std::runtime_error.
+        void write(const std::string& path) const;
+
+        uint64_t instructions() const { return instructions_; }
+        std::string current_stack() const { return stack_name(node_); }   // e.g. "main;sub_0244", as in the folded file
+
+    private:
+        // Coverage bits per byte of memory
+        static constexpr uint8_t EXECUTED = 0x1;
+        static constexpr uint8_t READ = 0x2;
+        static constexpr uint8_t WRITTEN = 0x4;
+
+        struct Node {
+            uint32_t parent;
+            uint16_t address;   // Subroutine entry point
+            uint16_t depth;
+            uint64_t count = 0; // Instructions run with this exact stack
+        };
+
+        uint64_t instructions_ = 0;
+        std::array<uint64_t, 256> handler_counts_ = {};
+        std::vector<uint64_t> pc_counts_;
+        std::vector<uint8_t> coverage_;
+
+        std::vector<Node> nodes_;                           // [0] is the top level
+        std::unordered_map<uint64_t, uint32_t> children_;  // node << 16 | address -> child node
+        uint32_t node_ = 0;                                 // Where the program is now
+        uint16_t max_depth_ = 0;
+
+        uint32_t rom_start_ = Utils::PROGRAM_START_ADDRESS;
+        uint32_t rom_size_ = 0;
+
+        void mark(uint32_t address, uint32_t length, uint8_t kind) {
+            for (uint32_t offset = 0; offset < length; offset++)
+                coverage_[(address + offset) & (Utils::MEMORY_SIZE - 1)] |= kind;
+        }
+        std::string stack_name(uint32_t node) const;
+        void write_json(const std::string& path) const;
+        void write_folded(const std::string& path) const;
+};
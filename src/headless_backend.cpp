@@ -0,0 +1,67 @@
+#include "headless_backend.h"
+#include "peripherals.h"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+HeadlessBackend::HeadlessBackend(const std::string& script_path) {
+    std::ifstream script(script_path);
+    if (!script)
+        throw std::runtime_error(std::format("Failed to open input script {}", script_path));
+
+    std::string line;
+    for (uint32_t line_num = 1; std::getline(script, line); line_num++) {
+        // Strip comments and skip blank lines
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+
+        InputEvent event{};
+        std::string key, action;
+        if (!(fields >> event.frame))
+            continue;
+
+        fields >> key >> action;
+        if (key == "quit") {
+            event.quit = true;
+        } else if (key.size() == 1 && std::isxdigit(static_cast<unsigned char>(key[0])) &&
+                   (action == "down" || action == "up")) {
+            event.key = std::stoi(key, nullptr, 16);
+            event.pressed = (action == "down");
+        } else {
+            throw std::runtime_error(std::format("Bad input script line {}: {}", line_num, line));
+        }
+        script_.push_back(event);
+    }
+
+    // Keep events on the same frame in file order
+    std::stable_sort(script_.begin(), script_.end(),
+        [](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+}
+
+bool HeadlessBackend::poll_input(uint64_t frame, Peripherals& peripherals) {
+    for (; next_event_ < script_.size() && script_[next_event_].frame <= frame; next_event_++) {
+        const InputEvent& event = script_[next_event_];
+        if (event.quit)
+            return true;
+        peripherals.key_event(event.key, event.pressed);
+    }
+    return false;
+}
+
+uint64_t HeadlessBackend::next_input_frame() const {
+    return next_event_ < script_.size() ? script_[next_event_].frame : UINT64_MAX;
+}
+
+uint64_t HeadlessBackend::ticks() const {
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+}
+
+uint64_t HeadlessBackend::tick_frequency() const {
+    using period = std::chrono::steady_clock::period;
+    return period::den / period::num;
+}
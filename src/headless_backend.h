@@ -0,0 +1,42 @@
+#pragma once
+
+#include "backend.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// No window, no audio device and no throttling. Input comes from an
+//  optional script and the last presented frame is kept in memory.
+//
+// Script format, one event per line ('#' starts a comment):
+//   <frame> <key 0-F> down|up
+//   <frame> quit
+class HeadlessBackend : public Backend {
+    public:
+        HeadlessBackend() = default;
+        explicit HeadlessBackend(const std::string& script_path);
+
+        void present(const Framebuffer& pixels) override { last_frame_ = pixels; }
+        void beep(uint64_t, bool) override {}
+        bool poll_input(uint64_t frame, Peripherals& peripherals) override;
+        uint64_t next_input_frame() const override;
+
+        bool real_time() const override { return false; }
+        uint64_t ticks() const override;
+        uint64_t tick_frequency() const override;
+        void delay(uint32_t) override {}
+
+        const Framebuffer& last_frame() const { return last_frame_; }
+
+    private:
+        struct InputEvent {
+            uint64_t frame;
+            uint8_t key;
+            bool pressed;
+            bool quit;
+        };
+        std::vector<InputEvent> script_;    // Sorted by frame
+        size_t next_event_ = 0;
+
+        Framebuffer last_frame_ = {};
+};
@@ -0,0 +1,337 @@
+#include "jit.h"
+#include "utilities.h"
+
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__) && defined(__unix__)
+    #define CHIP8_JIT_X64 1
+    #include <sys/mman.h>
+    #include <unistd.h>
+#else
+    #define CHIP8_JIT_X64 0
+#endif
+
+/*
+    Generated code layout
+
+    Entry:  rdi = CPU*, rsi = &V0
+    Pinned: rbx = &V0 (I and PC are addressed relative to it), r12 = CPU*
+    Scratch: rax, rcx, rdx
+
+    All guest state stays in the CPU object, so a callback always sees an
+    up-to-date machine and nothing has to be spilled around it.
+*/
+
+namespace {
+    constexpr uint8_t VF = 0xF;
+    constexpr uint8_t EXIT_SEQUENCE_SIZE = 10; // mov eax, imm32; pop x3; ret
+
+    // Switch the pages holding [start, start + length) between writable (to
+    //  copy a block in) and executable (to run it). No page is ever both.
+    bool protect(uint8_t* start, size_t length, bool writable) {
+#if CHIP8_JIT_X64
+        static const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t first = reinterpret_cast<uintptr_t>(start) & ~(page_size - 1);
+        uintptr_t end = reinterpret_cast<uintptr_t>(start) + length;
+        int prot = writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC;
+        return mprotect(reinterpret_cast<void*>(first), end - first, prot) == 0;
+#else
+        (void) start;
+        (void) length;
+        (void) writable;
+        return false;
+#endif
+    }
+}
+
+JIT::JIT(int32_t i_offset, int32_t pc_offset, const Quirks& quirks)
+    : i_offset_(i_offset),
+      pc_offset_(pc_offset),
+      quirks_(quirks)
+{
+#if CHIP8_JIT_X64
+    // Blocks are made executable as they are copied in (see compile)
+    void* buffer = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer != MAP_FAILED)
+        code_buffer_ = static_cast<uint8_t*>(buffer);
+#endif
+}
+
+JIT::~JIT() {
+#if CHIP8_JIT_X64
+    if (code_buffer_)
+        munmap(code_buffer_, CODE_BUFFER_SIZE);
+#endif
+}
+
+bool JIT::supported() {
+    return CHIP8_JIT_X64;
+}
+
+void JIT::flush() {
+    code_used_ = 0;
+}
+
+JIT::BlockFn JIT::compile(uint16_t start_address, const std::vector<Instruction>& block) {
+    if (!code_buffer_ || block.empty())
+        return nullptr;
+
+    code_.clear();
+    emit_prologue();
+
+    uint16_t address = start_address;
+    bool pc_synced = false;
+    for (uint32_t op_idx = 0; op_idx < block.size(); op_idx++) {
+        const Instruction& instruction = block[op_idx];
+
+        bool sets_pc = false;
+        if (emit_native(instruction.opcode, address, sets_pc)) {
+            pc_synced = sets_pc;
+        } else {
+            emit_callback(instruction.callback, instruction.opcode, address, op_idx + 1);
+            pc_synced = true;
+        }
+        address += 2;
+    }
+
+    // Straight-line code fell off the end of the block
+    if (!pc_synced)
+        emit_set_pc(address);
+    emit_return(block.size());
+
+    if (code_used_ + code_.size() > CODE_BUFFER_SIZE)
+        return nullptr;
+
+    // Earlier blocks sharing a page with this one can't run while it is
+    //  copied in, which is fine: compile is never called from generated code
+    uint8_t* entry = code_buffer_ + code_used_;
+    if (!protect(entry, code_.size(), true))
+        return nullptr;
+    std::memcpy(entry, code_.data(), code_.size());
+    if (!protect(entry, code_.size(), false))
+        throw std::runtime_error("Failed to make JIT code executable");
+    code_used_ += code_.size();
+    return reinterpret_cast<BlockFn>(entry);
+}
+
+/*
+    Emission Helpers
+*/
+void JIT::emit(std::initializer_list<uint8_t> bytes) {
+    code_.insert(code_.end(), bytes);
+}
+
+void JIT::emit16(uint16_t value) {
+    emit({static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)});
+}
+
+void JIT::emit32(uint32_t value) {
+    emit16(value);
+    emit16(value >> 16);
+}
+
+void JIT::emit64(uint64_t value) {
+    emit32(value);
+    emit32(value >> 32);
+}
+
+void JIT::emit_prologue() {
+    emit({0x53});               // push rbx
+    emit({0x41, 0x54});         // push r12
+    emit({0x55});               // push rbp (keeps calls 16-byte aligned)
+    emit({0x48, 0x89, 0xF3});   // mov rbx, rsi
+    emit({0x49, 0x89, 0xFC});   // mov r12, rdi
+}
+
+void JIT::emit_return(uint32_t executed) {
+    emit({0xB8}); emit32(executed); // mov eax, executed
+    emit({0x5D});                   // pop rbp
+    emit({0x41, 0x5C});             // pop r12
+    emit({0x5B});                   // pop rbx
+    emit({0xC3});                   // ret
+}
+
+void JIT::emit_set_pc(uint16_t address) {
+    emit({0x66, 0xC7, 0x83}); emit32(pc_offset_); emit16(address);  // mov word [rbx+pc], address
+}
+
+void JIT::emit_skip(uint16_t address, bool skip_if_equal) {
+    // Flags are already set by a compare; pick the next PC without branching
+    emit({0xB8}); emit32(address + 2);                              // mov eax, address+2
+    emit({0xB9}); emit32(address + 4);                              // mov ecx, address+4
+    emit({0x0F, static_cast<uint8_t>(skip_if_equal ? 0x44 : 0x45), 0xC1}); // cmove/cmovne eax, ecx
+    emit({0x66, 0x89, 0x83}); emit32(pc_offset_);                   // mov [rbx+pc], ax
+}
+
+void JIT::emit_callback(Callback callback, uint16_t opcode, uint16_t address, uint32_t executed) {
+    // Handlers read PC (calls, skips), so sync it before handing over
+    emit_set_pc(address);
+
+    emit({0x4C, 0x89, 0xE7});                                       // mov rdi, r12
+    emit({0xBE}); emit32(opcode);                                   // mov esi, opcode
+    emit({0x48, 0xB8}); emit64(reinterpret_cast<uint64_t>(callback)); // mov rax, callback
+    emit({0xFF, 0xD0});                                             // call rax
+
+    // Leave the block if the callback rewrote decoded code
+    emit({0x84, 0xC0});                                             // test al, al
+    emit({0x74, EXIT_SEQUENCE_SIZE});                               // jz continue
+    emit_return(executed);
+}
+
+bool JIT::emit_native(uint16_t opcode, uint16_t address, bool& sets_pc) {
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t nn = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+
+    // Skips that may have to step over a four byte F000 NNNN go through
+    //  the interpreter's handler
+    switch (opcode >> 12) {
+        case 0x3: case 0x4: case 0x5: case 0x9:
+            if (quirks_.long_skip)
+                return false;
+            break;
+        default:
+            break;
+    }
+
+    switch (opcode >> 12) {
+        case 0x1:
+            // Jump to nnn
+            emit_set_pc(nnn);
+            sets_pc = true;
+            return true;
+
+        case 0x3:
+        case 0x4:
+            // Skip if VX ==/!= NN
+            emit({0x80, 0x7B, x, nn});          // cmp byte [rbx+x], nn
+            emit_skip(address, (opcode >> 12) == 0x3);
+            sets_pc = true;
+            return true;
+
+        case 0x5:
+        case 0x9:
+            // Skip if VX ==/!= VY
+            if ((opcode & 0x000F) != 0)
+                return false;
+            emit({0x8A, 0x43, x});              // mov al, [rbx+x]
+            emit({0x3A, 0x43, y});              // cmp al, [rbx+y]
+            emit_skip(address, (opcode >> 12) == 0x5);
+            sets_pc = true;
+            return true;
+
+        case 0x6:
+            emit({0xC6, 0x43, x, nn});          // mov byte [rbx+x], nn
+            return true;
+
+        case 0x7:
+            emit({0x80, 0x43, x, nn});          // add byte [rbx+x], nn
+            return true;
+
+        case 0x8:
+            switch (opcode & 0x000F) {
+                case 0x0:
+                    emit({0x8A, 0x43, y});      // mov al, [rbx+y]
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    return true;
+                case 0x1:
+                case 0x2:
+                case 0x3: {
+                    // OR / AND / XOR, then reset VF (vf_reset quirk)
+                    static constexpr uint8_t ALU_OPS[] = {0x08, 0x20, 0x30};
+                    emit({0x8A, 0x43, y});                          // mov al, [rbx+y]
+                    emit({ALU_OPS[(opcode & 0x000F) - 1], 0x43, x});// op [rbx+x], al
+                    if (quirks_.vf_reset)
+                        emit({0xC6, 0x43, VF, 0x00});               // mov byte [rbx+VF], 0
+                    return true;
+                }
+                case 0x4:
+                    // VX += VY, VF = carry (written after VX)
+                    emit({0x8A, 0x43, x});      // mov al, [rbx+x]
+                    emit({0x02, 0x43, y});      // add al, [rbx+y]
+                    emit({0x0F, 0x92, 0xC1});   // setc cl
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    emit({0x88, 0x4B, VF});     // mov [rbx+VF], cl
+                    return true;
+                case 0x5:
+                    // VX -= VY, VF = !borrow
+                    emit({0x8A, 0x43, x});      // mov al, [rbx+x]
+                    emit({0x2A, 0x43, y});      // sub al, [rbx+y]
+                    emit({0x0F, 0x93, 0xC1});   // setnc cl
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    emit({0x88, 0x4B, VF});     // mov [rbx+VF], cl
+                    return true;
+                case 0x7:
+                    // VX = VY - VX, VF = !borrow
+                    emit({0x8A, 0x43, y});      // mov al, [rbx+y]
+                    emit({0x2A, 0x43, x});      // sub al, [rbx+x]
+                    emit({0x0F, 0x93, 0xC1});   // setnc cl
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    emit({0x88, 0x4B, VF});     // mov [rbx+VF], cl
+                    return true;
+                case 0x6:
+                    // VX = VY >> 1 (VX >> 1 without shift_vy), VF = shifted out bit
+                    emit({0x8A, 0x43, quirks_.shift_vy ? y : x});  // mov al, [rbx+src]
+                    emit({0x88, 0xC1});         // mov cl, al
+                    emit({0x80, 0xE1, 0x01});   // and cl, 1
+                    emit({0xD0, 0xE8});         // shr al, 1
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    emit({0x88, 0x4B, VF});     // mov [rbx+VF], cl
+                    return true;
+                case 0xE:
+                    // VX = VY << 1 (VX << 1 without shift_vy), VF = shifted out bit
+                    emit({0x8A, 0x43, quirks_.shift_vy ? y : x});  // mov al, [rbx+src]
+                    emit({0x88, 0xC1});         // mov cl, al
+                    emit({0xC0, 0xE9, 0x07});   // shr cl, 7
+                    emit({0xD0, 0xE0});         // shl al, 1
+                    emit({0x88, 0x43, x});      // mov [rbx+x], al
+                    emit({0x88, 0x4B, VF});     // mov [rbx+VF], cl
+                    return true;
+                default:
+                    return false;
+            }
+
+        case 0xA:
+            emit({0x66, 0xC7, 0x83}); emit32(i_offset_); emit16(nnn);  // mov word [rbx+i], nnn
+            return true;
+
+        case 0xB:
+            // Jump to NNN + V0 (XNN + VX with jump_vx)
+            emit({0x0F, 0xB6, 0x43, static_cast<uint8_t>(quirks_.jump_vx ? x : 0)}); // movzx eax, byte [rbx+reg]
+            emit({0x05}); emit32(nnn);                      // add eax, nnn
+            emit({0x66, 0x89, 0x83}); emit32(pc_offset_);   // mov [rbx+pc], ax
+            sets_pc = true;
+            return true;
+
+        case 0xF:
+            if (nn == 0x1E) {
+                // I += VX, VF = 1 when the legacy overflow check trips
+                emit({0x0F, 0xB7, 0x83}); emit32(i_offset_);    // movzx eax, word [rbx+i]
+                emit({0x0F, 0xB6, 0x4B, x});                    // movzx ecx, byte [rbx+x]
+                emit({0xBA}); emit32(UINT8_MAX);                // mov edx, 255
+                emit({0x29, 0xCA});                             // sub edx, ecx
+                emit({0x39, 0xD0});                             // cmp eax, edx
+                emit({0x76, 0x04});                             // jbe no_overflow
+                emit({0xC6, 0x43, VF, 0x01});                   // mov byte [rbx+VF], 1
+                emit({0x01, 0xC8});                             // no_overflow: add eax, ecx
+                emit({0x66, 0x89, 0x83}); emit32(i_offset_);    // mov [rbx+i], ax
+                return true;
+            }
+            if (nn == 0x29) {
+                // I = font character VX (matches op_fx29)
+                emit({0x0F, 0xB6, 0x43, x});                    // movzx eax, byte [rbx+x]
+                emit({0x83, 0xE0, 0x0F});                       // and eax, 0xF
+                emit({0x8D, 0x04, 0x80});                       // lea eax, [rax+rax*4]
+                emit({0x05}); emit32(Utils::FONT_START_ADDRESS); // add eax, font
+                emit({0x66, 0x89, 0x83}); emit32(i_offset_);    // mov [rbx+i], ax
+                return true;
+            }
+            return false;
+
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "quirks.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+class CPU;
+
+// x86-64 dynamic recompiler for the CPU's decoded blocks.
+//  Register, I and jump/skip opcodes are emitted as native code working on
+//  the CPU's register file in place; everything that touches peripherals,
+//  timers, the stack, memory or the RNG calls back into the C++ handlers.
+//  Quirk-dependent opcodes are emitted for the quirks the JIT was built with.
+//  Code buffer pages are either writable or executable, never both.
+class JIT {
+public:
+    // Runs one instruction through its C++ handler (including the PC
+    //  update). Returns true if the instruction rewrote decoded code.
+    using Callback = bool (*)(CPU* cpu, uint16_t opcode);
+
+    // Compiled block entry point. Returns the number of instructions executed
+    //  (less than the block length if a callback rewrote decoded code).
+    using BlockFn = uint32_t (*)(CPU* cpu, uint8_t* registers);
+
+    struct Instruction {
+        uint16_t opcode;
+        Callback callback;  // Used when the opcode has no native translation
+    };
+
+    JIT(int32_t i_offset, int32_t pc_offset, const Quirks& quirks);
+    ~JIT();
+
+    JIT(const JIT&) = delete;
+    JIT& operator=(const JIT&) = delete;
+
+    static bool supported();    // True if this host can run generated code
+    bool ready() const { return code_buffer_ != nullptr; }
+
+    // Translate a straight-line block starting at start_address.
+    //  Returns nullptr when the code buffer is full (flush and retry).
+    BlockFn compile(uint16_t start_address, const std::vector<Instruction>& block);
+    void flush();   // Discard all generated code
+
+private:
+    static constexpr size_t CODE_BUFFER_SIZE = 1 << 20;
+
+    uint8_t* code_buffer_ = nullptr;
+    size_t code_used_ = 0;
+
+    // Offsets of I and PC from V0 inside the CPU object
+    int32_t i_offset_;
+    int32_t pc_offset_;
+
+    Quirks quirks_;
+
+    // Emission helpers
+    std::vector<uint8_t> code_;
+    void emit(std::initializer_list<uint8_t> bytes);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+
+    void emit_prologue();
+    void emit_return(uint32_t executed);
+    void emit_set_pc(uint16_t address);
+    void emit_skip(uint16_t address, bool skip_if_equal);
+    void emit_callback(Callback callback, uint16_t opcode, uint16_t address, uint32_t executed);
+    bool emit_native(uint16_t opcode, uint16_t address, bool& sets_pc);
+};
@@ -0,0 +1,588 @@
+#include "lockstep.h"
+#include "headless_backend.h"
+
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+
+#if CHIP8_LOCKSTEP
+    #include <experimental/simd>
+    namespace stdx = std::experimental;
+#endif
+
+template <size_t Lanes>
+Lockstep<Lanes>::Lane::Lane(std::unique_ptr<Backend> backend)
+    : peripherals(backend ? std::move(backend) : std::make_unique<HeadlessBackend>()),
+      cpu(peripherals, ram, delay_timer, sound_timer) {}
+
+template <size_t Lanes>
+Lockstep<Lanes>::Lockstep(std::vector<std::unique_ptr<Backend>> backends) {
+    backends.resize(Lanes);
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        lanes_[lane] = std::make_unique<Lane>(std::move(backends[lane]));
+    }
+    active_lanes_.fill(0xFFFF);
+
+    // Every lane starts from the same reset state; without SIMD support
+    //  the lanes simply always run on their own
+    in_lockstep_ = false;
+    if (supported())
+        merge();
+}
+
+template <size_t Lanes>
+Lockstep<Lanes>::~Lockstep() = default;
+
+template <size_t Lanes>
+void Lockstep<Lanes>::load_rom(const std::string& rom_filepath, int start_address) {
+    for (auto& lane : lanes_) {
+        lane->ram.load_file(rom_filepath, start_address);
+    }
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::seed(size_t lane, uint32_t seed) {
+    lanes_[lane]->cpu.seed(seed);
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::set_cpu_engine(CPU::Engine engine) {
+    for (auto& lane : lanes_) {
+        lane->cpu.set_engine(engine);
+    }
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::set_profile(Profile profile) {
+    profile_ = profile;
+    for (auto& lane : lanes_) {
+        lane->cpu.set_profile(profile);
+    }
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::retire(size_t lane) {
+    quit_lane(lane);
+}
+
+template <size_t Lanes>
+typename Lockstep<Lanes>::Framebuffer Lockstep<Lanes>::framebuffer(size_t lane) const {
+    if (quit_mask_ & (1u << lane))
+        return final_framebuffers_[lane];
+    if (!in_lockstep_)
+        return lanes_[lane]->peripherals.framebuffer;
+
+    Framebuffer pixels;
+    for (size_t row = 0; row < Utils::PIXEL_HEIGHT; row++) {
+        pixels.row(0, row)[0] = framebuffer_[row][lane];
+    }
+    return pixels;
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::quit_lane(size_t lane) {
+    final_framebuffers_[lane] = framebuffer(lane);
+    quit_mask_ |= 1u << lane;
+    active_lanes_[lane] = 0;
+
+    // Stopped lanes are skipped per lane and ignored when comparing lanes
+    while (lead_ < Lanes - 1 && (quit_mask_ & (1u << lead_)))
+        lead_++;
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::run(uint64_t max_frames, uint64_t max_cycles) {
+    constexpr uint32_t ALL_LANES = (Lanes == 32) ? UINT32_MAX : (1u << Lanes) - 1;
+
+    // Mirrors Emulator::run_unthrottled, with per-lane input and results
+    while ((max_frames == 0 || frame_ < max_frames) && (max_cycles == 0 || cycle_ < max_cycles)) {
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            if (!(quit_mask_ & (1u << lane)) && lanes_[lane]->peripherals.process_input(frame_))
+                quit_lane(lane);
+        }
+        if (quit_mask_ == ALL_LANES)
+            break;
+
+        uint64_t frame_cycles = cycles_per_frame_;
+        if (max_cycles != 0)
+            frame_cycles = std::min(frame_cycles, max_cycles - cycle_);
+
+        run_cycles(frame_cycles);
+        cycle_ += frame_cycles;
+
+        // A cycle budget can stop mid-frame
+        if (frame_cycles == cycles_per_frame_) {
+            tick_timers();
+            frame_++;
+        }
+
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            if (!(quit_mask_ & (1u << lane))) {
+                lane_frames_[lane] = frame_;
+                lane_cycles_[lane] = cycle_;
+            }
+        }
+    }
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::run_cycles(uint64_t cycles) {
+    while (cycles > 0) {
+        if (in_lockstep_) {
+            // Every lane sits out the rest of the frame after a display wait
+            if (frame_wait_)
+                break;
+            uint16_t opcode;
+            if (!fetch(opcode) || !execute(opcode)) {
+                // Lanes disagree on the code, or the op needs a lane's own
+                //  CPU: run it per lane without using up a cycle here
+                split();
+                continue;
+            }
+            lockstep_cycles_++;
+            if (!pcs_match())
+                split();
+            cycles--;
+        } else {
+            // Lanes that split on a skip usually rejoin a few instructions
+            //  later. Once they've been apart for a while, hand each lane
+            //  the rest of the slice and only look for a rejoin after it.
+            uint64_t step = per_lane_streak_ < REJOIN_WINDOW ? 1 : cycles;
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (active_lanes_[lane])
+                    lanes_[lane]->cpu.run(step);
+            }
+            per_lane_cycles_ += step;
+            per_lane_streak_ += step;
+            cycles -= step;
+
+            // Rejoin once every lane is at the same PC (and none is
+            //  halfway through a key or display wait). The shared framebuffer only
+            //  holds a 64x32 single plane screen, so lanes using hires or
+            //  more planes stay apart.
+            bool aligned = supported();
+            for (size_t lane = 0; lane < Lanes && aligned; lane++) {
+                const Lane& target = *lanes_[lane];
+                aligned = !active_lanes_[lane] ||
+                    (target.cpu.pc_ == lanes_[lead_]->cpu.pc_ && !target.cpu.waiting_for_key_ && !target.cpu.frame_wait_ &&
+                     target.peripherals.plane_mask == 0x1 && target.peripherals.framebuffer.lores_single_plane());
+            }
+            if (aligned)
+                merge();
+        }
+    }
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::tick_timers() {
+    for (auto& lane : lanes_) {
+        lane->timer_clock.advance();
+        lane->cpu.vblank();
+    }
+    frame_wait_ = false;
+    if (!in_lockstep_)
+        return;
+
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        delay_[lane] -= (delay_[lane] > 0);
+        sound_[lane] -= (sound_[lane] > 0);
+    }
+}
+
+template <size_t Lanes>
+bool Lockstep<Lanes>::fetch(uint16_t& opcode) const {
+    uint16_t pc = pc_[lead_];
+    const RAM& ram = lanes_[lead_]->ram;
+    opcode = ram.read(pc) << 8 | ram.read(pc + 1);
+
+    // Once lanes have written different values, their code may not agree
+    if (memory_diverged_) {
+        for (size_t lane = 0; lane < Lanes; lane++) {
+            const RAM& lane_ram = lanes_[lane]->ram;
+            if (active_lanes_[lane] && (lane_ram.read(pc) << 8 | lane_ram.read(pc + 1)) != opcode)
+                return false;
+        }
+    }
+    return true;
+}
+
+template <size_t Lanes>
+bool Lockstep<Lanes>::pcs_match() const {
+#if CHIP8_LOCKSTEP
+    using Words = stdx::fixed_size_simd<uint16_t, Lanes>;
+    Words pc(pc_.data(), stdx::element_aligned);
+    Words active(active_lanes_.data(), stdx::element_aligned);
+    return stdx::all_of(((pc ^ Words(pc_[lead_])) & active) == Words(0));
+#else
+    return uniform(pc_);
+#endif
+}
+
+template <size_t Lanes>
+template <typename T>
+bool Lockstep<Lanes>::uniform(const std::array<T, Lanes>& values) const {
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        if (active_lanes_[lane] && values[lane] != values[lead_])
+            return false;
+    }
+    return true;
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::split() {
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        Lane& target = *lanes_[lane];
+        CPU& cpu = target.cpu;
+
+        for (size_t reg = 0; reg < v_.size(); reg++) {
+            cpu.v_[reg] = v_[reg][lane];
+        }
+        cpu.i_ = i_[lane];
+        cpu.pc_ = pc_[lane];
+        cpu.sp_ = sp_[lane];
+        for (size_t depth = 0; depth < stack_.size(); depth++) {
+            cpu.stack_[depth] = stack_[depth][lane];
+        }
+        cpu.frame_wait_ = frame_wait_;
+        target.delay_timer.set(delay_[lane]);
+        target.sound_timer.set(sound_[lane]);
+        for (size_t row = 0; row < Utils::PIXEL_HEIGHT; row++) {
+            target.peripherals.framebuffer.row(0, row)[0] = framebuffer_[row][lane];
+        }
+    }
+
+    // Lanes may now write different values to memory; merge() checks
+    memory_diverged_ = true;
+    in_lockstep_ = false;
+    per_lane_streak_ = 0;
+    divergences_++;
+}
+
+template <size_t Lanes>
+void Lockstep<Lanes>::merge() {
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        // Stopped lanes follow the lead lane so they can't trip up the rest
+        Lane& source = *lanes_[active_lanes_[lane] ? lane : lead_];
+        const CPU& cpu = source.cpu;
+
+        for (size_t reg = 0; reg < v_.size(); reg++) {
+            v_[reg][lane] = cpu.v_[reg];
+        }
+        i_[lane] = cpu.i_;
+        pc_[lane] = cpu.pc_;
+        sp_[lane] = cpu.sp_;
+        for (size_t depth = 0; depth < stack_.size(); depth++) {
+            stack_[depth][lane] = cpu.stack_[depth];
+        }
+        delay_[lane] = source.delay_timer.get();
+        sound_[lane] = source.sound_timer.get();
+        for (size_t row = 0; row < Utils::PIXEL_HEIGHT; row++) {
+            framebuffer_[row][lane] = source.peripherals.framebuffer.row(0, row)[0];
+        }
+    }
+
+    memory_diverged_ = false;
+    for (size_t lane = 0; lane < Lanes; lane++) {
+        if (active_lanes_[lane] && !lanes_[lane]->ram.same_contents(lanes_[lead_]->ram))
+            memory_diverged_ = true;
+    }
+    in_lockstep_ = true;
+}
+
+template <size_t Lanes>
+bool Lockstep<Lanes>::execute(uint16_t opcode) {
+    switch (profile_) {
+        #define PROFILE_CASE(name) \
+            case Profile::name: return execute<profile_quirks(Profile::name)>(opcode);
+        FOR_EACH_PROFILE(PROFILE_CASE)
+        #undef PROFILE_CASE
+    }
+    return false;
+}
+
+template <size_t Lanes>
+template <Quirks Q>
+bool Lockstep<Lanes>::execute(uint16_t opcode) {
+#if CHIP8_LOCKSTEP
+    using Bytes = stdx::fixed_size_simd<uint8_t, Lanes>;
+    using Words = stdx::fixed_size_simd<uint16_t, Lanes>;
+    constexpr auto aligned = stdx::element_aligned;
+
+    uint8_t x = (opcode & 0x0F00) >> 8;
+    uint8_t y = (opcode & 0x00F0) >> 4;
+    uint8_t n = opcode & 0x000F;
+    uint8_t nn = opcode & 0x00FF;
+    uint16_t nnn = opcode & 0x0FFF;
+
+    auto load = [&](uint8_t reg) { return Bytes(v_[reg].data(), aligned); };
+    auto store = [&](uint8_t reg, const Bytes& value) { value.copy_to(v_[reg].data(), aligned); };
+    auto set_pc = [&](const Words& pc) { pc.copy_to(pc_.data(), aligned); };
+    auto advance = [&]() { set_pc(Words(pc_.data(), aligned) + 2); };
+
+    // Skips: 2 or 4 bytes per lane; lanes that disagree are split afterwards
+    auto skip_if = [&](const typename Bytes::mask_type& condition) {
+        Bytes step(2);
+        stdx::where(condition, step) = 4;
+
+        // XO-CHIP skips step over all four bytes of F000 NNNN, as in CPU::skip
+        if constexpr (Q.long_skip) {
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                const RAM& ram = lanes_[lane]->ram;
+                uint16_t next = pc_[lane] + 2;
+                if (active_lanes_[lane] && condition[lane] && (ram.read(next) << 8 | ram.read(next + 1)) == 0xF000)
+                    step[lane] = 6;
+            }
+        }
+        set_pc(Words(pc_.data(), aligned) + stdx::static_simd_cast<Words>(step));
+    };
+
+    // Flags are computed from the inputs and VF is written last, as in
+    //  CPU::op_8xy4/op_8xy5/op_8xy7, so VF wins when x is F
+    auto store_with_flag = [&](const Bytes& result, const typename Bytes::mask_type& flag) {
+        Bytes vf(0);
+        stdx::where(flag, vf) = 1;
+        store(x, result);
+        store(0xF, vf);
+    };
+
+    switch (opcode >> 12) {
+        case 0x0:
+            if (opcode == 0x00E0) {
+                for (auto& row : framebuffer_) {
+                    row.fill(0);
+                }
+                advance();
+                return true;
+            }
+            if (opcode == 0x00EE) {
+                for (size_t lane = 0; lane < Lanes; lane++) {
+                    if (sp_[lane] == 0)
+                        throw std::runtime_error("Stack underflow!");
+                    pc_[lane] = stack_[--sp_[lane]][lane] + 2;
+                }
+                return true;
+            }
+            return false;
+
+        case 0x1:
+            set_pc(Words(nnn));
+            return true;
+
+        case 0x2:
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (sp_[lane] >= Utils::STACK_DEPTH)
+                    throw std::runtime_error("Stack overflow!");
+                stack_[sp_[lane]++][lane] = pc_[lane];
+            }
+            set_pc(Words(nnn));
+            return true;
+
+        case 0x3:
+            skip_if(load(x) == Bytes(nn));
+            return true;
+        case 0x4:
+            skip_if(load(x) != Bytes(nn));
+            return true;
+        case 0x5:
+            if (n != 0)
+                return false;
+            skip_if(load(x) == load(y));
+            return true;
+        case 0x9:
+            if (n != 0)
+                return false;
+            skip_if(load(x) != load(y));
+            return true;
+
+        case 0x6:
+            store(x, Bytes(nn));
+            advance();
+            return true;
+
+        case 0x7:
+            store(x, load(x) + Bytes(nn));
+            advance();
+            return true;
+
+        case 0x8: {
+            Bytes vx = load(x);
+            Bytes vy = load(y);
+            Bytes shifted = Q.shift_vy ? vy : vx;   // 8xy6/8xyE source
+            switch (n) {
+                case 0x0: store(x, vy); break;
+                case 0x1: store(x, vx | vy); if (Q.vf_reset) store(0xF, Bytes(0)); break;
+                case 0x2: store(x, vx & vy); if (Q.vf_reset) store(0xF, Bytes(0)); break;
+                case 0x3: store(x, vx ^ vy); if (Q.vf_reset) store(0xF, Bytes(0)); break;
+                case 0x4: store_with_flag(vx + vy, vx > Bytes(UINT8_MAX) - vy); break;
+                case 0x5: store_with_flag(vx - vy, vx >= vy); break;
+                case 0x7: store_with_flag(vy - vx, vx <= vy); break;
+                case 0x6: store_with_flag(shifted >> 1, (shifted & Bytes(0x1)) != Bytes(0)); break;
+                case 0xE: store_with_flag(shifted << 1, (shifted & Bytes(0x80)) != Bytes(0)); break;
+                default: return false;
+            }
+            advance();
+            return true;
+        }
+
+        case 0xA:
+            Words(nnn).copy_to(i_.data(), aligned);
+            advance();
+            return true;
+
+        case 0xB:
+            set_pc(Words(nnn) + stdx::static_simd_cast<Words>(load(Q.jump_vx ? x : 0)));
+            return true;
+
+        case 0xC:
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                v_[x][lane] = lanes_[lane]->cpu.rand_() & nn;
+            }
+            advance();
+            return true;
+
+        case 0xD: {
+            // Same sprite rules as CPU::op_dxyn and Framebuffer::draw on a
+            //  lores plane, per lane
+            uint8_t rows = n;
+            bool wide = false;
+            if constexpr (Q.large_sprites) {
+                if (rows == 0) {
+                    rows = 16;
+                    wide = true;
+                }
+            }
+            const uint8_t sprite_bytes = wide ? 2 * rows : rows;
+            const unsigned sprite_bits = wide ? 16 : 8;
+
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (!active_lanes_[lane])
+                    continue;
+                uint8_t draw_x = v_[x][lane] % Utils::PIXEL_WIDTH;
+                uint8_t draw_y = v_[y][lane] % Utils::PIXEL_HEIGHT;
+                uint8_t lane_rows = Q.clip_sprites ? std::min<uint8_t>(rows, Utils::PIXEL_HEIGHT - draw_y) : rows;
+                std::array<uint8_t, 32> sprite;
+                lanes_[lane]->ram.read_span(i_[lane], std::span<uint8_t>(sprite.data(), sprite_bytes));
+
+                bool collision = false;
+                for (uint8_t row_idx = 0; row_idx < lane_rows; row_idx++) {
+                    uint64_t bits = wide ? (sprite[2 * row_idx] << 8 | sprite[2 * row_idx + 1]) : sprite[row_idx];
+                    bits <<= 64 - sprite_bits;
+                    uint64_t& row = framebuffer_[(draw_y + row_idx) % Utils::PIXEL_HEIGHT][lane];
+
+                    uint64_t head = bits >> draw_x;
+                    collision |= (row & head) != 0;
+                    row ^= head;
+
+                    // Without clipping the rest wraps around to the left edge
+                    if (!Q.clip_sprites && draw_x > Utils::PIXEL_WIDTH - sprite_bits) {
+                        uint64_t tail = bits << (Utils::PIXEL_WIDTH - draw_x);
+                        collision |= (row & tail) != 0;
+                        row ^= tail;
+                    }
+                }
+                v_[0xF][lane] = collision;
+            }
+            if constexpr (Q.display_wait)
+                frame_wait_ = true;
+            advance();
+            return true;
+        }
+
+        case 0xE: {
+            if (nn != 0x9E && nn != 0xA1)
+                return false;
+            typename Bytes::mask_type pressed(false);
+            for (size_t lane = 0; lane < Lanes; lane++) {
+                if (!active_lanes_[lane])
+                    continue;
+                pressed[lane] = lanes_[lane]->peripherals.key_state[v_[x][lane]];
+            }
+            skip_if(nn == 0x9E ? pressed : !pressed);
+            return true;
+        }
+
+        case 0xF:
+            switch (nn) {
+                case 0x07:
+                    store(x, Bytes(delay_.data(), aligned));
+                    break;
+                case 0x15:
+                    load(x).copy_to(delay_.data(), aligned);
+                    break;
+                case 0x18:
+                    load(x).copy_to(sound_.data(), aligned);
+                    break;
+                case 0x1E: {
+                    // I += VX; VF only ever gets set, as in CPU::op_fx1e
+                    Words i(i_.data(), aligned);
+                    Words vx = stdx::static_simd_cast<Words>(load(x));
+                    Words overflow(0);
+                    stdx::where(i > Words(UINT8_MAX) - vx, overflow) = 1;
+                    (i + vx).copy_to(i_.data(), aligned);
+                    store(0xF, load(0xF) | stdx::static_simd_cast<Bytes>(overflow));
+                    break;
+                }
+                case 0x29:
+                    for (size_t lane = 0; lane < Lanes; lane++) {
+                        i_[lane] = CPU::font_address(v_[x][lane]);
+                    }
+                    break;
+                case 0x30:
+                    for (size_t lane = 0; lane < Lanes; lane++) {
+                        i_[lane] = CPU::hires_font_address(v_[x][lane]);
+                    }
+                    break;
+                case 0x33:
+                    memory_diverged_ |= !uniform(i_) || !uniform(v_[x]);
+                    for (size_t lane = 0; lane < Lanes; lane++) {
+                        if (active_lanes_[lane])
+                            lanes_[lane]->ram.write_span(i_[lane], CPU::bcd(v_[x][lane]));
+                    }
+                    break;
+                case 0x55:
+                    memory_diverged_ |= !uniform(i_);
+                    for (uint8_t reg = 0; reg <= x; reg++) {
+                        memory_diverged_ |= !uniform(v_[reg]);
+                    }
+                    for (size_t lane = 0; lane < Lanes; lane++) {
+                        if (!active_lanes_[lane])
+                            continue;
+                        std::array<uint8_t, 16> values;
+                        for (uint8_t reg = 0; reg <= x; reg++) {
+                            values[reg] = v_[reg][lane];
+                        }
+                        lanes_[lane]->ram.write_span(i_[lane], std::span<const uint8_t>(values.data(), x + 1));
+                        i_[lane] += CPU::index_increment<Q>(x);
+                    }
+                    break;
+                case 0x65:
+                    for (size_t lane = 0; lane < Lanes; lane++) {
+                        if (!active_lanes_[lane])
+                            continue;
+                        std::array<uint8_t, 16> values;
+                        lanes_[lane]->ram.read_span(i_[lane], std::span<uint8_t>(values.data(), x + 1));
+                        for (uint8_t reg = 0; reg <= x; reg++) {
+                            v_[reg][lane] = values[reg];
+                        }
+                        i_[lane] += CPU::index_increment<Q>(x);
+                    }
+                    break;
+                default:
+                    // Fx0A waits on each lane's own input
+                    return false;
+            }
+            advance();
+            return true;
+
+        default:
+            return false;
+    }
+#else
+    (void)opcode;
+    return false;
+#endif
+}
+
+template class Lockstep<8>;
+template class Lockstep<16>;
+template class Lockstep<32>;
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "backend.h"
+#include "cpu.h"
+#include "peripherals.h"
+#include "ram.h"
+#include "timer.h"
+#include "utilities.h"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if __has_include(<experimental/simd>)
+    #define CHIP8_LOCKSTEP 1
+#else
+    #define CHIP8_LOCKSTEP 0
+#endif
+
+// Runs Lanes instances of the same ROM side by side (different seeds or
+//  inputs). While every lane is at the same PC the registers, timers and
+//  framebuffers live in struct-of-arrays form and each opcode executes
+//  across all lanes at once with std::experimental::simd. When lanes
+//  diverge the state is handed to one CPU per lane, which step on their
+//  own until their PCs line up again.
+template <size_t Lanes>
+class Lockstep {
+public:
+    static_assert(Lanes == 8 || Lanes == 16 || Lanes == 32, "Lockstep supports 8, 16 or 32 lanes");
+
+    // Missing or null backends default to headless
+    explicit Lockstep(std::vector<std::unique_ptr<Backend>> backends = {});
+    ~Lockstep();
+
+    static bool supported() { return CHIP8_LOCKSTEP; }
+
+    void load_rom(const std::string& rom_filepath, int start_address = Utils::PROGRAM_START_ADDRESS);
+    void seed(size_t lane, uint32_t seed);  // Per-lane Cxnn random stream
+    void retire(size_t lane);               // Drop an unused lane before run()
+    void set_cpu_engine(CPU::Engine engine);  // Engine for lanes running on their own
+    void set_profile(Profile profile);        // Quirks for every lane, SIMD or not
+    void set_cycles_per_frame(uint32_t cycles) { cycles_per_frame_ = cycles; }
+
+    // Same contract as Emulator::run. A lane whose input script quits
+    //  stops counting frames and cycles, and its framebuffer is frozen.
+    void run(uint64_t max_frames = 0, uint64_t max_cycles = 0);
+
+    using Framebuffer = Backend::Framebuffer;
+    Framebuffer framebuffer(size_t lane) const;
+    uint64_t frames(size_t lane) const { return lane_frames_[lane]; }
+    uint64_t cycles(size_t lane) const { return lane_cycles_[lane]; }
+
+    // Divergence statistics
+    uint64_t lockstep_cycles() const { return lockstep_cycles_; }   // Cycles run across all lanes at once
+    uint64_t per_lane_cycles() const { return per_lane_cycles_; }   // Cycles run one lane at a time
+    uint64_t divergences() const { return divergences_; }           // Switches to per-lane execution
+
+private:
+    // Per-lane machine, used for memory, input and per-lane execution
+    struct Lane {
+        Peripherals peripherals;
+        RAM ram;
+        TimerClock timer_clock;
+        Timer delay_timer{timer_clock};
+        Timer sound_timer{timer_clock};
+        CPU cpu;
+
+        explicit Lane(std::unique_ptr<Backend> backend);
+    };
+    std::array<std::unique_ptr<Lane>, Lanes> lanes_;
+
+    // Struct-of-arrays state, valid while in_lockstep_
+    alignas(64) std::array<std::array<uint8_t, Lanes>, 16> v_{};
+    alignas(64) std::array<uint16_t, Lanes> i_{};
+    alignas(64) std::array<uint16_t, Lanes> pc_{};
+    alignas(64) std::array<uint16_t, Lanes> sp_{};
+    alignas(64) std::array<std::array<uint16_t, Lanes>, Utils::STACK_DEPTH> stack_{};
+    alignas(64) std::array<uint8_t, Lanes> delay_{};
+    alignas(64) std::array<uint8_t, Lanes> sound_{};
+    alignas(64) std::array<std::array<uint64_t, Lanes>, Utils::PIXEL_HEIGHT> framebuffer_{};  // Lores, first plane
+    alignas(64) std::array<uint16_t, Lanes> active_lanes_{};   // 0xFFFF until the lane quits
+
+    bool in_lockstep_ = true;
+    bool memory_diverged_ = false;  // Lanes may hold different code
+    bool frame_wait_ = false;       // Every lane drew under the display_wait quirk
+
+    Profile profile_ = Profile::Modern;
+    uint32_t cycles_per_frame_ = Utils::CYCLES_PER_FRAME;
+
+    uint64_t frame_ = 0;
+    uint64_t cycle_ = 0;
+    uint32_t quit_mask_ = 0;        // Lanes whose input script quit
+    size_t lead_ = 0;               // First lane still running
+    std::array<uint64_t, Lanes> lane_frames_{};
+    std::array<uint64_t, Lanes> lane_cycles_{};
+    std::array<Framebuffer, Lanes> final_framebuffers_{};
+
+    uint64_t lockstep_cycles_ = 0;
+    uint64_t per_lane_cycles_ = 0;
+    uint64_t divergences_ = 0;
+
+    static constexpr uint64_t REJOIN_WINDOW = 64;  // Cycles stepped one at a time after a split
+    uint64_t per_lane_streak_ = 0;                  // Cycles since the last split
+
+    void run_cycles(uint64_t cycles);
+    void tick_timers();
+    void quit_lane(size_t lane);
+
+    bool execute(uint16_t opcode);  // One opcode on every lane, false if it needs per-lane execution
+    template <Quirks Q> bool execute(uint16_t opcode);
+    bool fetch(uint16_t& opcode) const;
+    bool pcs_match() const;
+    template <typename T>
+    bool uniform(const std::array<T, Lanes>& values) const;  // Same value in every running lane
+
+    void split();   // Struct-of-arrays -> per-lane CPUs
+    void merge();   // Per-lane CPUs -> struct-of-arrays
+};
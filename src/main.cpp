@@ -1,9 +1,17 @@
 
 #include "emulator.h"
+#include "guest_profiler.h"
+#include "headless_backend.h"
+#include "sdl_backend.h"
 #include "utilities.h"
 #include "print.h"
+#include "movie.h"
+#include "save_state.h"
+#include <algorithm>
 #include <filesystem>
+#include <memory>
 #include <random>
+#include <string>
 
 int main(int argc, char* argv[]) {
 
@@ -14,15 +22,164 @@ int main(int argc, char* argv[]) {
 
     std::filesystem::path rompath(argv[1]);
 
-    if (rompath.extension() !=  ".ch8" ) {
-        PRINT_ERROR("Please ensure the first argument is a .ch8 file");
+    // The extension picks the default quirk profile
+    Profile profile = default_profile(rompath.extension().string());
+    if (rompath.extension() != ".ch8" && rompath.extension() != ".sc8" && rompath.extension() != ".xo8") {
+        PRINT_ERROR("Please ensure the first argument is a .ch8, .sc8 or .xo8 file");
     }
 
-    Emulator emulator;
+    // Parse optional flags following the rom file
+    CPU::Engine engine = CPU::Engine::Interpreter;
+    bool headless = false;
+    std::string input_script;
+    uint64_t max_frames = 0;
+    Speed speed = Speed::Normal;
+    uint32_t cycles_per_frame = Utils::CYCLES_PER_FRAME;
+    Sync sync = Sync::Clock;
+    std::string load_state;
+    std::string save_state;
+    uint32_t rewind_seconds = Utils::REWIND_SECONDS;
+    uint32_t run_ahead = 0;
+    uint32_t seed = 0;
+    std::string record_movie;
+    std::string play_movie;
+    std::string guest_profile;
+    std::string stats_file;
+    uint32_t stats_interval = Utils::STATS_INTERVAL_SECONDS;
+    for (int arg_idx = 2; arg_idx < argc; arg_idx++) {
+        std::string arg(argv[arg_idx]);
+
+        if (arg == "--engine=interpreter") {
+            engine = CPU::Engine::Interpreter;
+        } else if (arg == "--engine=cached") {
+            engine = CPU::Engine::Cached;
+        } else if (arg == "--engine=jit") {
+            engine = CPU::Engine::Jit;
+        } else if (arg == "--engine=aot") {
+            engine = CPU::Engine::Aot;
+        } else if (arg == "--headless") {
+            headless = true;
+        } else if (arg.starts_with("--input=")) {
+            input_script = arg.substr(std::string("--input=").size());
+        } else if (arg.starts_with("--frames=")) {
+            max_frames = std::stoull(arg.substr(std::string("--frames=").size()));
+        } else if (arg == "--speed=1x") {
+            speed = Speed::Normal;
+        } else if (arg == "--speed=2x") {
+            speed = Speed::Double;
+        } else if (arg == "--speed=max") {
+            speed = Speed::Unthrottled;
+        } else if (arg == "--speed=slow") {
+            speed = Speed::SlowMotion;
+        } else if (arg.starts_with("--cycles-per-frame=")) {
+            cycles_per_frame = std::stoul(arg.substr(std::string("--cycles-per-frame=").size()));
+        } else if (arg == "--sync=clock") {
+            sync = Sync::Clock;
+        } else if (arg == "--sync=audio") {
+            sync = Sync::Audio;
+        } else if (arg.starts_with("--profile=")) {
+            if (!parse_profile(arg.substr(std::string("--profile=").size()), profile))
+                PRINT_ERROR("Unknown profile %s", arg.c_str());
+        } else if (arg.starts_with("--load-state=")) {
+            load_state = arg.substr(std::string("--load-state=").size());
+        } else if (arg.starts_with("--save-state=")) {
+            save_state = arg.substr(std::string("--save-state=").size());
+        } else if (arg.starts_with("--rewind=")) {
+            rewind_seconds = std::stoul(arg.substr(std::string("--rewind=").size()));
+        } else if (arg.starts_with("--run-ahead=")) {
+            run_ahead = std::stoul(arg.substr(std::string("--run-ahead=").size()));
+        } else if (arg.starts_with("--seed=")) {
+            seed = std::stoul(arg.substr(std::string("--seed=").size()));
+        } else if (arg.starts_with("--record=")) {
+            record_movie = arg.substr(std::string("--record=").size());
+        } else if (arg.starts_with("--play=")) {
+            play_movie = arg.substr(std::string("--play=").size());
+        } else if (arg.starts_with("--guest-profile=")) {
+            guest_profile = arg.substr(std::string("--guest-profile=").size());
+        } else if (arg.starts_with("--stats=")) {
+            stats_file = arg.substr(std::string("--stats=").size());
+        } else if (arg.starts_with("--stats-interval=")) {
+            stats_interval = std::max(1ul, std::stoul(arg.substr(std::string("--stats-interval=").size())));
+        } else {
+            PRINT_ERROR("Unknown option %s", arg.c_str());
+        }
+    }
+
+    // Movies run from reset, all the way through
+    if (!record_movie.empty() && !play_movie.empty())
+        PRINT_ERROR("--record and --play can't be used together");
+    if ((!record_movie.empty() || !play_movie.empty()) && !load_state.empty())
+        PRINT_ERROR("Movies start from reset, so can't be combined with --load-state");
+
+    // Pick the host backend: SDL window and audio, or nothing at all
+    std::unique_ptr<Backend> backend;
+    if (headless) {
+        backend = input_script.empty() ? std::make_unique<HeadlessBackend>()
+                                       : std::make_unique<HeadlessBackend>(input_script);
+    } else {
+        if (!input_script.empty())
+            PRINT_ERROR("--input requires --headless");
+        backend = std::make_unique<SdlBackend>();
+    }
+
+    Emulator emulator(std::move(backend));
+    emulator.set_cpu_engine(engine);
+    emulator.set_profile(profile);
+    emulator.set_speed(speed);
+    emulator.set_cycles_per_frame(cycles_per_frame);
+    emulator.set_sync(sync);
+    if (seed != 0)
+        emulator.seed(seed);
+    if (!headless) {
+        emulator.set_rewind(rewind_seconds);   // Headless runs have no key to rewind with
+        emulator.set_run_ahead(run_ahead);     // ... and no one waiting on the screen
+    }
+    std::unique_ptr<GuestProfiler> profiler;
+    if (!guest_profile.empty()) {
+        profiler = std::make_unique<GuestProfiler>();
+        emulator.set_guest_profiler(profiler.get());
+    }
     emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+    emulator.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
     emulator.load_rom(rompath.string());
 
-    emulator.run();
+    if (!load_state.empty()) {
+        std::string path;
+        size_t index;
+        parse_state_spec(load_state, path, index);
+        MappedStates states(path);
+        if (index >= states.size())
+            PRINT_ERROR("%s holds only %zu states", path.c_str(), states.size());
+        emulator.load_state(states[index]);
+    }
+
+    Movie movie;
+    if (!record_movie.empty()) {
+        if (seed != 0)
+            movie.seed = seed;
+        emulator.record_movie(movie, rompath.string());
+    } else if (!play_movie.empty()) {
+        movie = Movie(play_movie);
+        emulator.play_movie(movie, rompath.string());
+        if (max_frames == 0)
+            max_frames = movie.frames;
+    }
+
+    if (!stats_file.empty())
+        emulator.export_stats(stats_file, stats_interval);
+
+    emulator.run(max_frames);
+
+    if (!record_movie.empty())
+        movie.save(record_movie);
+    if (profiler)
+        profiler->write(guest_profile);
+
+    if (!save_state.empty()) {
+        auto state = std::make_unique<SaveState>();
+        emulator.save_state(*state);
+        write_state_file(save_state, std::span<const SaveState>(state.get(), 1));
+    }
 
     return 0;
-}
\ No newline at end of file
+}
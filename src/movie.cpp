@@ -0,0 +1,117 @@
+#include "movie.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    // Header fields are written one at a time, little-endian, so the file
+    //  doesn't depend on struct layout
+    template <typename T>
+    void put(std::string& out, T value) {
+        for (size_t idx = 0; idx < sizeof(T); idx++)
+            out.push_back(static_cast<char>(static_cast<uint64_t>(value) >> (8 * idx) & 0xFF));
+    }
+
+    template <typename T>
+    T get(const std::string& in, size_t& pos) {
+        if (pos + sizeof(T) > in.size())
+            throw std::runtime_error("Movie file is truncated");
+        uint64_t value = 0;
+        for (size_t idx = 0; idx < sizeof(T); idx++)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(in[pos++])) << (8 * idx);
+        return static_cast<T>(value);
+    }
+
+    void put_varint(std::string& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    uint64_t get_varint(const std::string& in, size_t& pos) {
+        uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            uint8_t byte = get<uint8_t>(in, pos);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Movie file is corrupt");
+    }
+
+    std::string read_file(const std::string& path, const char* what) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error(std::string("Failed to open ") + what + " " + path);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+}
+
+Movie::Movie(const std::string& path) {
+    std::string in = read_file(path, "movie");
+    if (in.size() < sizeof(MAGIC) || std::memcmp(in.data(), MAGIC, sizeof(MAGIC)) != 0)
+        throw std::runtime_error("Not a movie file: " + path);
+
+    size_t pos = sizeof(MAGIC);
+    if (get<uint32_t>(in, pos) != VERSION)
+        throw std::runtime_error("Movie is from another version: " + path);
+    seed = get<uint32_t>(in, pos);
+
+    // Settings are applied as they are, so anything out of range is refused
+    uint8_t profile_id = get<uint8_t>(in, pos);
+    if (profile_id > static_cast<uint8_t>(Profile::Modern))
+        throw std::runtime_error("Movie has an unknown profile: " + path);
+    profile = static_cast<Profile>(profile_id);
+    cycles_per_frame = get<uint32_t>(in, pos);
+    if (cycles_per_frame == 0)
+        throw std::runtime_error("Movie has no cycles per frame: " + path);
+
+    rom_hash = get<uint32_t>(in, pos);
+    frames = get<uint64_t>(in, pos);
+
+    uint64_t count = get<uint64_t>(in, pos);
+    uint64_t frame = 0;
+    for (uint64_t idx = 0; idx < count; idx++) {
+        frame += get_varint(in, pos);
+        uint8_t packed = get<uint8_t>(in, pos);
+        events_.push_back({frame, static_cast<uint8_t>(packed & 0xF), (packed & 0x10) != 0});
+    }
+}
+
+void Movie::save(const std::string& path) const {
+    std::string out(MAGIC, sizeof(MAGIC));
+    put(out, VERSION);
+    put(out, seed);
+    put(out, static_cast<uint8_t>(profile));
+    put(out, cycles_per_frame);
+    put(out, rom_hash);
+    put(out, frames);
+
+    put(out, static_cast<uint64_t>(events_.size()));
+    uint64_t frame = 0;
+    for (const Event& event : events_) {
+        put_varint(out, event.frame - frame);
+        put(out, static_cast<uint8_t>(event.key | (event.pressed ? 0x10 : 0)));
+        frame = event.frame;
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.write(out.data(), static_cast<std::streamsize>(out.size())))
+        throw std::runtime_error("Failed to write movie file " + path);
+}
+
+void Movie::truncate(uint64_t frame) {
+    auto first = std::find_if(events_.begin(), events_.end(), [frame](const Event& event) { return event.frame >= frame; });
+    events_.erase(first, events_.end());
+}
+
+uint32_t Movie::hash_rom(const std::string& rom_path) {
+    std::string rom = read_file(rom_path, "ROM");
+    return Utils::fnv1a(reinterpret_cast<const uint8_t*>(rom.data()), rom.size());
+}
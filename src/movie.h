@@ -0,0 +1,51 @@
+#pragma once
+
+#include "quirks.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A recorded session: every keypad change, stamped with the frame it
+//  reached the program on, plus everything else a run depends on (the
+//  random seed, quirk profile, instructions per frame and which ROM).
+//  Input only ever reaches the CPU between frames, so playing the events
+//  back on the same frames reproduces the session exactly, at any speed
+//  and with any engine.
+//
+// File format: a fixed header, then one event per keypad change as the
+//  frames since the previous event (LEB128) and a byte holding the key
+//  and whether it went down. A typical event is two bytes.
+class Movie {
+    public:
+        struct Event {
+            uint64_t frame;
+            uint8_t key;
+            bool pressed;
+        };
+
+        Movie() = default;
+        explicit Movie(const std::string& path);    // Throws std::runtime_error
+        void save(const std::string& path) const;   // Throws std::runtime_error
+
+        // Recording. Events must come in frame order; truncate drops those
+        //  from `frame` on, for when the session is rewound.
+        void record(uint64_t frame, uint8_t key, bool pressed) { events_.push_back({frame, key, pressed}); }
+        void truncate(uint64_t frame);
+
+        const std::vector<Event>& events() const { return events_; }
+
+        // Run settings, set before recording and applied before playback
+        uint32_t seed = 1;
+        Profile profile = Profile::Modern;
+        uint32_t cycles_per_frame = 0;
+        uint32_t rom_hash = 0;
+        uint64_t frames = 0;    // Length of the session
+
+        static uint32_t hash_rom(const std::string& rom_path);  // Throws std::runtime_error
+
+    private:
+        static constexpr char MAGIC[4] = {'C', '8', 'M', 'V'};
+        static constexpr uint32_t VERSION = 1;
+
+        std::vector<Event> events_;
+};
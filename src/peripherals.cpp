@@ -1,179 +1,154 @@
 #include "peripherals.h"
+#include "headless_backend.h"
+#include "movie.h"
 #include "utilities.h"
 #include "print.h"
+#include <algorithm>
 #include <stdexcept>
 #include <format>
 
-Peripherals::Peripherals() {
-    sdl_init();
+Peripherals::Peripherals()
+    : Peripherals(std::make_unique<HeadlessBackend>()) {}
+
+Peripherals::Peripherals(std::unique_ptr<Backend> backend)
+    : backend_(std::move(backend))
+{
     render_display();
 }
 
-Peripherals::~Peripherals() {
-    sdl_cleanup();
-}
-
-/*
-    SDL Management Functions
-*/
-
-void Peripherals::sdl_init() {
-
-    // Initialize SDL
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
-        throw std::runtime_error(std::format("Failed to initialize SDL: %s\n", SDL_GetError()));
-
-    // Create the SDL window
-    window_ = SDL_CreateWindow(
-        Utils::WINDOW_TITLE,
-        SDL_WINDOWPOS_UNDEFINED,
-        SDL_WINDOWPOS_UNDEFINED,
-        Utils::WINDOW_WIDTH,
-        Utils::WINDOW_HEIGHT,
-        SDL_WINDOW_SHOWN);
-    if (!window_)
-        throw std::runtime_error(std::format("Failed to create SDL window: %s\n", SDL_GetError()));
-
-    // Create the SDL renderer
-    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
-    if (!renderer_)
-        throw std::runtime_error(std::format("Failed to create SDL renderer: %s\n", SDL_GetError()));
-
-    // Create the SDL texture
-    texture_ = SDL_CreateTexture(
-        renderer_, 
-        SDL_PIXELFORMAT_RGBA8888,
-        SDL_TEXTUREACCESS_STREAMING,
-        Utils::PIXEL_WIDTH,
-        Utils::PIXEL_HEIGHT
-    );
-    if (!texture_)
-        throw std::runtime_error(std::format("Failed to create SDL texture: %s\n", SDL_GetError()));
-
-    // Set up the SDL Audio
-    SDL_AudioSpec desired, obtained;
-    desired.freq = Utils::AUDIO_RATE_HZ;
-    desired.format = AUDIO_S16SYS;
-    desired.channels = 1;
-    desired.samples = Utils::AUDIO_BUFFER_SIZE;
-    desired.callback = audio_callback;
-    desired.userdata = nullptr;
-    audio_device_ = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
-    if (!audio_device_)
-        throw std::runtime_error(std::format("Failed to create SDL audio: %s\n", SDL_GetError()));
-}
-
-void Peripherals::sdl_cleanup() {
-    if (audio_device_) {
-        SDL_CloseAudioDevice(audio_device_);
-        audio_device_ = 0;
-    }
-
-    if (texture_) {
-        SDL_DestroyTexture(texture_);
-        texture_ = nullptr;
-    }
-    
-    if (renderer_) {
-        SDL_DestroyRenderer(renderer_);
-        renderer_ = nullptr;
-    }
-
-    if (window_) {
-        SDL_DestroyWindow(window_);
-        window_ = nullptr;
-    }
-
-    SDL_Quit();
-}
+Peripherals::~Peripherals() = default;
 
 /*
     Display Management Functions
 */
 void Peripherals::clear_pixel_buffer() {
-    pixel_buffer.fill(Utils::PIXEL_OFF_UINT32);
+    framebuffer.clear(plane_mask);
 }
 
 void Peripherals::render_display() {
-
-    // Update the SDL texture with the contents of pixel_buffer
-    SDL_UpdateTexture(texture_, nullptr, pixel_buffer.data(), Utils::PIXEL_WIDTH*sizeof(pixel_buffer[0]));
-
-    // Copy the texture to the renderer and present
-    SDL_RenderCopy(renderer_, texture_, nullptr, nullptr);
-    SDL_RenderPresent(renderer_);
+    backend_->present(framebuffer);
 }
 
 void Peripherals::set_pixel(uint16_t x, uint16_t y, bool on) {
     // Validate pixel position
-    if (x >= Utils::PIXEL_WIDTH || y >= Utils::PIXEL_HEIGHT)
-        throw std::runtime_error(std::format("Invalid pixel set (x:%d, y:%d)", x, y));
+    if (x >= framebuffer.width() || y >= framebuffer.height())
+        throw std::runtime_error(std::format("Invalid pixel set (x:{:}, y:{:})", x, y));
     
     // Update pixel value
-    pixel_buffer[y * Utils::PIXEL_WIDTH + x] = on ? Utils::PIXEL_ON_UINT32 : Utils::PIXEL_OFF_UINT32;
+    uint64_t mask = uint64_t{1} << (63 - x % 64);
+    uint64_t& word = framebuffer.row(0, y)[x / 64];
+    word = on ? (word | mask) : (word & ~mask);
 }
 
 bool Peripherals::check_pixel(uint16_t x, uint16_t y) {
     // Validate pixel position
-    if (x >= Utils::PIXEL_WIDTH || y >= Utils::PIXEL_HEIGHT)
+    if (x >= framebuffer.width() || y >= framebuffer.height())
         throw std::runtime_error(std::format("Invalid pixel check (x:{:}, y:{:}", x, y));
 
     // Check pixel
-    return pixel_buffer[y * Utils::PIXEL_WIDTH + x] == Utils::PIXEL_ON_UINT32;
+    return framebuffer.plane_pixel(0, x, y);
 }
 
 /*
     Sound Management Functions
 */
-void Peripherals::beep(bool enable) {
-    SDL_PauseAudioDevice(audio_device_, static_cast<int>(!enable));
+void Peripherals::beep(uint64_t frame, bool enable) {
+    backend_->beep(frame, enable);
 }
 
-void Peripherals::audio_callback(void *userdata, Uint8 *stream, int len) {
-    (void) userdata;
-    for (int i = 0; i < len; ++i) {
-        float phase = 2.0f * M_PI * Utils::BEEP_TONE_HZ * i / Utils::AUDIO_RATE_HZ;
-        stream[i] = static_cast<int16_t>(Utils::BEEP_AMPLITUDE * std::sin(phase) * INT16_MAX);
-    }
+void Peripherals::audio_pattern(uint64_t frame, const Backend::AudioPattern& pattern, uint8_t pitch) {
+    backend_->audio_pattern(frame, pattern, pitch);
+}
+
+/*
+    Save State Functions
+*/
+void Peripherals::save(State& state) const {
+    state.framebuffer = framebuffer;
+    state.plane_mask = plane_mask;
+    state.audio_buffer = audio_buffer;
+    state.audio_pitch = audio_pitch;
+    std::copy_n(key_state, state.key_state.size(), state.key_state.begin());
+    state.input_flag = input_flag;
+    state.last_key = last_key;
+}
+
+void Peripherals::load(const State& state) {
+    framebuffer = state.framebuffer;
+    plane_mask = state.plane_mask;
+
+    // Hand a restored audio pattern to the backend at the end of the frame
+    if (audio_buffer != state.audio_buffer || audio_pitch != state.audio_pitch)
+        audio_changed = true;
+    audio_buffer = state.audio_buffer;
+    audio_pitch = state.audio_pitch;
+
+    std::copy_n(state.key_state.begin(), state.key_state.size(), key_state);
+    input_flag = state.input_flag;
+    last_key = state.last_key;
 }
 
 /*
     User IO Functions
 */
-bool Peripherals::process_input() {
-    SDL_Event event;
-    while (SDL_PollEvent(&event)) {
-        switch (event.type) {
-            case SDL_QUIT: 
-            {
-                return true; 
-            }
-            case SDL_KEYDOWN:
-            {
-                // Handle key press
-                if (event.key.repeat == 0) {
-                    auto key_iter = Utils::KEY_MAPPING.find(event.key.keysym.sym);
-                    if (key_iter != Utils::KEY_MAPPING.end()) {
-                        key_state[key_iter->second] = true;
-                        input_flag = true;
-                        last_key = key_iter->second;
-                    }
-                }
-                break;
-            }
-            case SDL_KEYUP:
-            {
-                // Handle key release
-                auto key_iter = Utils::KEY_MAPPING.find(event.key.keysym.sym);
-                if (key_iter != Utils::KEY_MAPPING.end()) {
-                    key_state[key_iter->second] = false;
-                }
-                break;
-            }
-            default: 
-                break;
-        }
+bool Peripherals::process_input(uint64_t frame) {
+    input_frame_ = frame;
+    bool quit = backend_->poll_input(frame, *this);
+
+    if (playing_) {
+        const std::vector<Movie::Event>& events = playing_->events();
+        for (; next_movie_event_ < events.size() && events[next_movie_event_].frame <= frame; next_movie_event_++)
+            apply_key(events[next_movie_event_].key, events[next_movie_event_].pressed);
     }
-    return false;
+    return quit;
+}
+
+void Peripherals::key_event(uint8_t key, bool pressed) {
+    // A movie being played stands in for the user
+    if (playing_)
+        return;
+    if (recording_)
+        recording_->record(input_frame_, key, pressed);
+    apply_key(key, pressed);
 }
 
+uint64_t Peripherals::next_input_frame() const {
+    uint64_t frame = backend_->next_input_frame();
+    if (playing_) {
+        const std::vector<Movie::Event>& events = playing_->events();
+        frame = std::min(frame, next_movie_event_ < events.size() ? events[next_movie_event_].frame : UINT64_MAX);
+    }
+    return frame;
+}
+
+void Peripherals::play(const Movie* movie) {
+    playing_ = movie;
+    next_movie_event_ = 0;
+}
+
+void Peripherals::rewound(uint64_t frame) {
+    // Input from `frame` on hasn't happened any more
+    if (recording_)
+        recording_->truncate(frame);
+    if (playing_) {
+        const std::vector<Movie::Event>& events = playing_->events();
+        while (next_movie_event_ > 0 && events[next_movie_event_ - 1].frame >= frame)
+            next_movie_event_--;
+    }
+
+    // The keypad came back with the state; the keys really held may differ
+    uint16_t keys = 0;
+    for (uint8_t key = 0; key < 16; key++) {
+        if (key_state[key])
+            keys |= static_cast<uint16_t>(1u << key);
+    }
+    backend_->keys_restored(keys);
+}
+
+void Peripherals::apply_key(uint8_t key, bool pressed) {
+    key_state[key] = pressed;
+    if (pressed) {
+        input_flag = true;
+        last_key = key;
+    }
+}
@@ -1,43 +1,78 @@
 #pragma once
 
+#include "backend.h"
+#include "framebuffer.h"
 #include "utilities.h"
-#include <SDL2/SDL.h>
 #include <array>
+#include <memory>
+
+class Movie;
 
 class Peripherals {
     public:
-        Peripherals();
+        Peripherals();  // Headless, with no scripted input
+        explicit Peripherals(std::unique_ptr<Backend> backend);
         ~Peripherals();
     
         // Display handling
-        void clear_pixel_buffer();
+        void clear_pixel_buffer();  // Clears the selected planes
         void render_display();
-        void set_pixel(uint16_t x, uint16_t y, bool on);
+        void set_pixel(uint16_t x, uint16_t y, bool on);    // First plane, current resolution
         bool check_pixel(uint16_t x, uint16_t y);
-        std::array<uint32_t,Utils::PIXEL_WIDTH*Utils::PIXEL_HEIGHT> pixel_buffer = {};
 
-        // Audio handling
-        void beep(bool enable);
+        // Packed bitplanes, expanded to RGBA only when the display is rendered
+        Framebuffer framebuffer;
+        uint8_t plane_mask = 0x1;   // Planes drawn, cleared and scrolled (XO-CHIP Fn01)
+
+        // Audio handling, stamped with the emulated frame they apply from
+        void beep(uint64_t frame, bool enable);
+        void audio_pattern(uint64_t frame, const Backend::AudioPattern& pattern, uint8_t pitch);
+
+        // XO-CHIP audio state (F002, Fx3A); handed to the backend at the end
+        //  of the frame it changed in
+        Backend::AudioPattern audio_buffer = {};
+        uint8_t audio_pitch = Utils::AUDIO_PATTERN_BASE_PITCH;
+        bool audio_changed = false;
 
         // User IO handling
-        bool process_input();    // Captures user input, returns true if quit detected
+        bool process_input(uint64_t frame);  // Captures user input, returns true if quit detected
+        void key_event(uint8_t key, bool pressed);  // From the backend
+        uint64_t next_input_frame() const;   // Earliest frame input could arrive on
         bool key_state[16] = {}; // Key state storage
         bool input_flag = false; // Input event flag
         uint8_t last_key = 0;    // Last key pressed
 
-    private:
+        // Save states: the screen, XO-CHIP audio and the keypad
+        struct State {
+            Framebuffer framebuffer;
+            uint8_t plane_mask;
+            Backend::AudioPattern audio_buffer;
+            uint8_t audio_pitch;
+            std::array<bool, 16> key_state;
+            bool input_flag;
+            uint8_t last_key;
+        };
+        void save(State& state) const;
+        void load(const State& state);
 
-        // SDL objects and helpers
-        SDL_Window* window_ = nullptr;
-        SDL_Renderer* renderer_ = nullptr;
-        SDL_Texture* texture_ = nullptr;
-        SDL_AudioDeviceID audio_device_ = 0;
-        
-        void sdl_init();    // Initialize SDL display and audio
-        void sdl_cleanup(); // De-init SDL display and audio        
+        // Movies (see movie.h): log the backend's key events as they are
+        //  delivered, or ignore them and deliver a recording's instead.
+        //  rewound() keeps either in step when the emulator goes back, and
+        //  has the backend resend any keys the restored keypad got wrong.
+        void record(Movie* movie) { recording_ = movie; }
+        void play(const Movie* movie);
+        void rewound(uint64_t frame);
+
+        Backend& backend() { return *backend_; }
+        const Backend& backend() const { return *backend_; }
+
+    private:
+        std::unique_ptr<Backend> backend_;  // Host display, audio, input and clock
 
-        // Audio functions
-        static void audio_callback(void *userdata, Uint8 *stream, int len);
+        Movie* recording_ = nullptr;
+        const Movie* playing_ = nullptr;
+        size_t next_movie_event_ = 0;
+        uint64_t input_frame_ = 0;      // Frame being polled for
 
-        
+        void apply_key(uint8_t key, bool pressed);
 };
\ No newline at end of file
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Behaviours that differ between CHIP-8 platforms. The CPU's execution
+//  core takes these as a template parameter, so every quirk check is
+//  resolved at compile time.
+struct Quirks {
+    // How far Fx55/Fx65 move I past the registers they transfer
+    enum class IndexIncrement : uint8_t {
+        None,       // I is left alone
+        X,          // I += X (CHIP-48's off-by-one)
+        XPlusOne,   // I += X + 1
+    };
+
+    bool vf_reset;                      // 8xy1/8xy2/8xy3 clear VF
+    bool shift_vy;                      // 8xy6/8xyE shift VY into VX, rather than VX in place
+    IndexIncrement memory_increment;    // Fx55/Fx65
+    bool jump_vx;                       // Bxnn jumps to xnn + VX, rather than nnn + V0
+    bool clip_sprites;                  // Dxyn clips sprites at the edges, rather than wrapping them
+    bool display_wait;                  // Dxyn waits for the next frame before the program goes on
+    bool large_sprites;                 // Dxy0 draws a 16x16 sprite, rather than nothing
+    bool long_skip;                     // Skips step over all four bytes of F000 NNNN
+
+    constexpr bool operator==(const Quirks&) const = default;
+};
+
+// Named quirk sets, picked per ROM at runtime
+enum class Profile {
+    Vip,        // COSMAC VIP, the original interpreter
+    Chip48,     // CHIP-48 on the HP-48
+    Schip11,    // SUPER-CHIP 1.1
+    XoChip,     // XO-CHIP (Octo)
+    Modern,     // Original CHIP-8 semantics without the VIP's wait for the display
+};
+
+// Expands M(name) for every Profile, used to stamp out one instantiation each
+#define FOR_EACH_PROFILE(M) M(Vip) M(Chip48) M(Schip11) M(XoChip) M(Modern)
+
+constexpr Quirks profile_quirks(Profile profile) {
+    using enum Quirks::IndexIncrement;
+    switch (profile) {
+        //                                 VF reset Shift VY Memory    Jump VX Clip   Wait   16x16  Long skip
+        case Profile::Vip:     return Quirks{true,  true,  XPlusOne, false, true,  true,  false, false};
+        case Profile::Chip48:  return Quirks{false, false, X,        true,  true,  false, false, false};
+        case Profile::Schip11: return Quirks{false, false, None,     true,  true,  false, true,  false};
+        case Profile::XoChip:  return Quirks{false, true,  XPlusOne, false, false, false, true,  true };
+        case Profile::Modern:
+        default:               return Quirks{true,  true,  XPlusOne, false, true,  false, false, false};
+    }
+}
+
+constexpr const char* profile_name(Profile profile) {
+    switch (profile) {
+        case Profile::Vip:     return "vip";
+        case Profile::Chip48:  return "chip48";
+        case Profile::Schip11: return "schip";
+        case Profile::XoChip:  return "xochip";
+        case Profile::Modern:
+        default:               return "modern";
+    }
+}
+
+// Profile a ROM runs under unless told otherwise, from its file extension
+constexpr Profile default_profile(std::string_view extension) {
+    if (extension == ".sc8")
+        return Profile::Schip11;
+    if (extension == ".xo8")
+        return Profile::XoChip;
+    return Profile::Modern;
+}
+
+// Bytes of memory a profile's programs can address: XO-CHIP's 64K, or
+//  the 4K every earlier platform had
+constexpr uint32_t profile_memory_size(Profile profile) {
+    return profile == Profile::XoChip ? 0x10000 : 0x1000;
+}
+
+// Parses a name from profile_name(), returns false if there is no such profile
+constexpr bool parse_profile(std::string_view name, Profile& profile) {
+    for (Profile candidate : {Profile::Vip, Profile::Chip48, Profile::Schip11, Profile::XoChip, Profile::Modern}) {
+        if (name == profile_name(candidate)) {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -4,30 +4,33 @@
 #include <array>
 #include <stdexcept>
 #include <fstream>
+#include <algorithm>
+#include <vector>
 
-RAM::RAM() {
+template <size_t Size, MemoryPolicy Policy>
+MemoryBus<Size, Policy>::MemoryBus() {
     erase_ram();
 }
 
-uint8_t RAM::read(uint16_t address) const {
-    if (address >= Utils::MEMORY_SIZE) {
-        throw std::out_of_range("Address out of range");
-    }
-    return memory[address];
-}
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::set_size(uint32_t size) {
+    if (size == 0 || size > Size || (size & (size - 1)) != 0)
+        throw std::invalid_argument("Memory size must be a power of two up to " + std::to_string(Size));
 
-void RAM::write(uint16_t address, uint8_t value) {
-    if (address >= Utils::MEMORY_SIZE) {
-        throw std::out_of_range("Address out of range");
-    }
-    memory[address] = value;
+    // Out of reach memory reads as zero if it comes back
+    if (size < size_)
+        std::fill(memory.begin() + size, memory.begin() + size_, 0);
+    size_ = size;
 }
 
-void RAM::erase_ram() {
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::erase_ram() {
     memory.fill(0); // Fill the memory with zeros
+    flag_bulk_write(0, Size);
 }
 
-void RAM::load_file(const std::string& filename, uint16_t address) {
+template <size_t Size, MemoryPolicy Policy>
+uint16_t MemoryBus<Size, Policy>::load_file(const std::string& filename, uint32_t address) {
     std::ifstream file(filename, std::ios::binary | std::ios::ate );
     if (!file) {
         throw std::runtime_error("Failed to open file: " + filename);
@@ -36,33 +39,116 @@ void RAM::load_file(const std::string& filename, uint16_t address) {
     std::streamsize filesize = file.tellg();
     file.seekg(0, std::ios::beg);
 
-    if (filesize + address - Utils::MEMORY_START_ADDRESS > Utils::MEMORY_SIZE) {
+    if (filesize + address - Utils::MEMORY_START_ADDRESS > static_cast<std::streamsize>(size_)) {
         throw std::out_of_range("File \"%s\" cannot be written -- requested write location results in writes exceeding memory size");
     }
 
-    if (!file.read(reinterpret_cast<char*>(&memory[address]), filesize))
+    std::vector<uint8_t> contents(static_cast<size_t>(filesize));
+    if (!file.read(reinterpret_cast<char*>(contents.data()), filesize))
     {
         throw std::runtime_error("Failed to read file: " + filename);
     }
+    write_span(address, contents);
 
     #ifdef DEBUG
         //mem_dump(address, filesize);
     #endif
 
-    
+    return static_cast<uint16_t>(filesize);
 }
 
-void RAM::mem_dump(uint16_t address, uint16_t length) const
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::mem_dump(uint32_t address, uint32_t length) const
 {
     printf("Memdump -- Addr %04x, %d bytes\n", address, length);
-    uint16_t end_address = address + length;
+    uint32_t end_address = address + length;
 
     while (address < end_address)
     {
-        uint8_t value = memory[address - Utils::MEMORY_START_ADDRESS];
+        uint8_t value = read(address - Utils::MEMORY_START_ADDRESS);
         if (value != 0)
             printf("%04X: %02X\n", address, value);
         address++;
     }
 }
 
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::restore(const std::array<uint8_t, Size>& contents) {
+    // Close in on the differing span a chunk at a time with memcmp, then
+    //  to the exact byte, so unchanged code next to changed data isn't
+    //  flagged as rewritten
+    constexpr size_t CHUNK = std::min<size_t>(256, Size);
+    size_t start = 0;
+    while (start < size_ && std::memcmp(memory.data() + start, contents.data() + start, CHUNK) == 0)
+        start += CHUNK;
+    if (start == size_)
+        return;
+    size_t end = size_;
+    while (std::memcmp(memory.data() + end - CHUNK, contents.data() + end - CHUNK, CHUNK) == 0)
+        end -= CHUNK;
+
+    while (memory[start] == contents[start])
+        start++;
+    while (memory[end - 1] == contents[end - 1])
+        end--;
+
+    std::memcpy(memory.data() + start, contents.data() + start, end - start);
+    flag_bulk_write(static_cast<uint32_t>(start), static_cast<uint32_t>(end));
+}
+
+/*
+    Code Tracking Functions
+*/
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::mark_code(uint32_t start, uint32_t end) {
+    for (uint32_t address = start; address < end && address < size_; address++) {
+        code_map_[address] = true;
+    }
+}
+
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::clear_code_marks() {
+    code_map_.fill(false);
+    code_dirty_ = false;
+}
+
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::clear_code_marks(uint32_t start, uint32_t end) {
+    std::fill(code_map_.begin() + std::min<size_t>(start, Size), code_map_.begin() + std::min<size_t>(end, Size), false);
+}
+
+template <size_t Size, MemoryPolicy Policy>
+bool MemoryBus<Size, Policy>::take_code_writes(uint32_t& start, uint32_t& end) {
+    if (!code_dirty_)
+        return false;
+
+    start = dirty_start_;
+    end = dirty_end_;
+    code_dirty_ = false;
+    return true;
+}
+
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::flag_code_write(uint32_t start, uint32_t end) {
+    // Grow the pending dirty range so the CPU can invalidate in one pass
+    if (code_dirty_) {
+        dirty_start_ = std::min(dirty_start_, start);
+        dirty_end_ = std::max(dirty_end_, end);
+    } else {
+        dirty_start_ = start;
+        dirty_end_ = end;
+        code_dirty_ = true;
+    }
+}
+
+template <size_t Size, MemoryPolicy Policy>
+void MemoryBus<Size, Policy>::flag_bulk_write(uint32_t start, uint32_t end) {
+    if (std::any_of(code_map_.begin() + start, code_map_.begin() + end, [](bool is_code) { return is_code; }))
+        flag_code_write(start, end);
+}
+
+// Room for XO-CHIP's 64K under every policy; classic profiles address
+//  the first 4K of it
+template class MemoryBus<65536, MemoryPolicy::Throw>;
+template class MemoryBus<65536, MemoryPolicy::Mask>;
+template class MemoryBus<65536, MemoryPolicy::Trap>;
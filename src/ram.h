@@ -1,20 +1,145 @@
 #pragma once
 
 #include "utilities.h"
+#include <algorithm>
 #include <array>
 #include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
 #include <string>
 
-class RAM {
-public: 
-    RAM();
+// What an access outside of memory does
+enum class MemoryPolicy {
+    Throw,  // Throw std::out_of_range
+    Mask,   // Wrap the address around memory; no checks or exception paths at all
+    Trap,   // Read 0, drop writes and raise the fault flag
+};
+
+// Emulated memory with room for Size bytes. The access policy is a
+//  template parameter so each instantiation's read/write compile down to
+//  exactly one kind of check.
+//
+// How much of it the program can address is set at runtime, per profile
+//  (4K classic, 64K XO-CHIP): out-of-range checks and masking use that
+//  size, so a classic program can't run past 0xFFF. The storage stays
+//  the same either way, so a profile change never swaps the bus itself.
+template <size_t Size, MemoryPolicy Policy>
+class MemoryBus {
+public:
+    static_assert(Size != 0 && (Size & (Size - 1)) == 0, "Memory size must be a power of two");
+    static constexpr size_t SIZE = Size;
+    static constexpr MemoryPolicy POLICY = Policy;
+
+    MemoryBus();
+
+    // Addressable bytes, a power of two up to Size. Shrinking clears the
+    //  memory that drops out of reach.
+    void set_size(uint32_t size);
+    uint32_t size() const { return size_; }
+
+    uint8_t read(uint32_t address) const {
+        if constexpr (Policy == MemoryPolicy::Mask) {
+            return memory[address & (size_ - 1)];
+        } else {
+            if (address >= size_) {
+                out_of_range(address);
+                return 0;
+            }
+            return memory[address];
+        }
+    }
+
+    void write(uint32_t address, uint8_t value) {
+        if constexpr (Policy == MemoryPolicy::Mask) {
+            address &= size_ - 1;
+        } else if (address >= size_) {
+            out_of_range(address);
+            return;
+        }
+        memory[address] = value;
+
+        if (code_map_[address])
+            flag_code_write(address, address + 1);
+    }
+
+    // Bulk access for block loads and stores (Fx33, Fx55, Fx65, ROMs).
+    //  Ranges that fit are copied in one go; anything running off the end
+    //  goes byte by byte through the access policy.
+    void read_span(uint32_t address, std::span<uint8_t> out) const {
+        if (address <= size_ && out.size() <= size_ - address) {
+            std::memcpy(out.data(), memory.data() + address, out.size());
+            return;
+        }
+        for (size_t offset = 0; offset < out.size(); offset++)
+            out[offset] = read(static_cast<uint32_t>(address + offset));
+    }
+
+    void write_span(uint32_t address, std::span<const uint8_t> data) {
+        if (address <= size_ && data.size() <= size_ - address) {
+            std::memcpy(memory.data() + address, data.data(), data.size());
+            flag_bulk_write(address, static_cast<uint32_t>(address + data.size()));
+            return;
+        }
+        for (size_t offset = 0; offset < data.size(); offset++)
+            write(static_cast<uint32_t>(address + offset), data[offset]);
+    }
 
-    uint8_t read(uint16_t address) const;
-    void write(uint16_t address, uint8_t value);
     void erase_ram();
-    void load_file(const std::string& filename, uint16_t address = 0);
-    void mem_dump(uint16_t address, uint16_t length) const;
-    
+    uint16_t load_file(const std::string& filename, uint32_t address = 0); // Returns bytes loaded
+    void mem_dump(uint32_t address, uint32_t length) const;
+    bool same_contents(const MemoryBus& other) const { return memory == other.memory; }
+
+    // Save states: all of memory in one copy. Restoring only writes the
+    //  span that differs within the addressable size and flags it like any
+    //  other write, so decoded code outside it stays cached.
+    const std::array<uint8_t, Size>& contents() const { return memory; }
+    void restore(const std::array<uint8_t, Size>& contents);
+
+    // Trap policy: set by the first access outside of memory
+    bool faulted() const { return faulted_; }
+    uint32_t fault_address() const { return fault_address_; }
+    void clear_fault() { faulted_ = false; }
+
+    // Code tracking (used by the CPU's decoded block cache)
+    void mark_code(uint32_t start, uint32_t end);   // Flag [start, end) as decoded code
+    void clear_code_marks();                        // Forget all decoded code ranges
+    void clear_code_marks(uint32_t start, uint32_t end); // Forget decoded code in [start, end)
+    bool code_dirty() const { return code_dirty_; } // True if flagged code was written
+    bool take_code_writes(uint32_t& start, uint32_t& end); // Pop the dirty range [start, end)
+
 private:
-    std::array<uint8_t, Utils::MEMORY_SIZE> memory; // Memory array of size MEMORY_SIZE
-};
\ No newline at end of file
+    std::array<uint8_t, Size> memory; // Memory array of size Size
+    uint32_t size_ = Size;            // Addressable part of it
+
+    std::array<bool, Size> code_map_ = {}; // Addresses covered by decoded blocks
+    bool code_dirty_ = false;
+    uint32_t dirty_start_ = 0;
+    uint32_t dirty_end_ = 0;
+
+    mutable bool faulted_ = false;
+    mutable uint32_t fault_address_ = 0;
+
+    void out_of_range(uint32_t address) const {
+        if constexpr (Policy == MemoryPolicy::Throw) {
+            throw std::out_of_range("Address out of range");
+        } else if (!faulted_) {
+            faulted_ = true;
+            fault_address_ = address;
+        }
+    }
+
+    void flag_code_write(uint32_t start, uint32_t end);
+    void flag_bulk_write(uint32_t start, uint32_t end); // Flags only if the range holds code
+};
+
+// The bus the emulator is built with: checked by default, masked for
+//  builds that define CHIP8_MEMORY_MASK (release batch runs), trapping
+//  with CHIP8_MEMORY_TRAP
+#if defined(CHIP8_MEMORY_MASK)
+    using RAM = MemoryBus<Utils::MEMORY_SIZE, MemoryPolicy::Mask>;
+#elif defined(CHIP8_MEMORY_TRAP)
+    using RAM = MemoryBus<Utils::MEMORY_SIZE, MemoryPolicy::Trap>;
+#else
+    using RAM = MemoryBus<Utils::MEMORY_SIZE, MemoryPolicy::Throw>;
+#endif
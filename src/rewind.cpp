@@ -0,0 +1,149 @@
+#include "rewind.h"
+
+#include <cstring>
+#include <utility>
+
+namespace {
+    constexpr size_t SKIP_CHUNK = 32;   // Words compared at once while skipping unchanged state
+    constexpr unsigned char ZERO_CHUNK[SKIP_CHUNK * sizeof(uint64_t)] = {};
+
+    // States are read and written as words through memcpy, which compiles
+    //  to plain loads and stores without breaking aliasing rules
+    uint64_t load_word(const unsigned char* bytes, size_t word) {
+        uint64_t value;
+        std::memcpy(&value, bytes + word * sizeof(uint64_t), sizeof(uint64_t));
+        return value;
+    }
+
+    void store_word(unsigned char* bytes, size_t word, uint64_t value) {
+        std::memcpy(bytes + word * sizeof(uint64_t), &value, sizeof(uint64_t));
+    }
+}
+
+Rewind::Rewind(size_t max_frames, size_t max_bytes, uint32_t keyframe_interval)
+    : max_frames_(max_frames),
+      max_bytes_(max_bytes),
+      keyframe_interval_(keyframe_interval),
+      current_(std::make_unique<SaveState>()),
+      next_(std::make_unique<SaveState>()) {
+    scratch_.reserve(WORDS);
+}
+
+void Rewind::capture() {
+    Frame frame;
+    frame.keyframe = frames_.empty() || since_keyframe_ + 1 >= keyframe_interval_;
+    encode(*next_, frame.keyframe ? nullptr : current_.get(), scratch_);
+    frame.runs.assign(scratch_.begin(), scratch_.end());
+
+    if (frame.keyframe) {
+        keyframes_++;
+        since_keyframe_ = 0;
+    } else {
+        since_keyframe_++;
+    }
+    bytes_ += frame_bytes(frame);
+    frames_.push_back(std::move(frame));
+
+    // The state just captured is the newest; the old one gets overwritten
+    //  by the next capture
+    std::swap(current_, next_);
+
+    while ((frames_.size() > max_frames_ || bytes_ > max_bytes_) && keyframes_ > 1)
+        drop_oldest_segment();
+}
+
+const SaveState* Rewind::step_back() {
+    if (frames_.size() < 2)
+        return nullptr;
+
+    Frame newest = std::move(frames_.back());
+    frames_.pop_back();
+    bytes_ -= frame_bytes(newest);
+
+    if (!newest.keyframe) {
+        // XOR is its own inverse: the delta that led here leads back
+        apply(newest.runs, *current_);
+        since_keyframe_--;
+        return current_.get();
+    }
+
+    // A keyframe doesn't know the frame before it: replay the previous
+    //  segment from its keyframe
+    keyframes_--;
+    size_t start = frames_.size() - 1;
+    while (!frames_[start].keyframe)
+        start--;
+    std::memset(static_cast<void*>(current_.get()), 0, sizeof(SaveState));
+    for (size_t idx = start; idx < frames_.size(); idx++)
+        apply(frames_[idx].runs, *current_);
+    since_keyframe_ = static_cast<uint32_t>(frames_.size() - 1 - start);
+    return current_.get();
+}
+
+void Rewind::clear() {
+    frames_.clear();
+    bytes_ = 0;
+    keyframes_ = 0;
+    since_keyframe_ = 0;
+}
+
+void Rewind::drop_oldest_segment() {
+    do {
+        bytes_ -= frame_bytes(frames_.front());
+        frames_.pop_front();
+    } while (!frames_.front().keyframe);
+    keyframes_--;
+}
+
+/*
+    Run-length XOR coding
+*/
+void Rewind::encode(const SaveState& state, const SaveState* reference, std::vector<uint64_t>& runs) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&state);
+    const auto* ref_bytes = reinterpret_cast<const unsigned char*>(reference);
+    auto ref_word = [&](size_t word) { return reference ? load_word(ref_bytes, word) : 0; };
+
+    runs.clear();
+    size_t word = 0;
+    size_t last_end = 0;
+    while (word < WORDS) {
+        // Unchanged state is most of it: skip whole chunks with memcmp,
+        //  then the odd words up to the next change
+        while (word + SKIP_CHUNK <= WORDS &&
+               std::memcmp(bytes + word * sizeof(uint64_t), reference ? ref_bytes + word * sizeof(uint64_t) : ZERO_CHUNK,
+                   sizeof(ZERO_CHUNK)) == 0)
+            word += SKIP_CHUNK;
+        while (word < WORDS && load_word(bytes, word) == ref_word(word))
+            word++;
+        if (word == WORDS)
+            break;
+
+        // One run of changed words. A lone unchanged word inside it is
+        //  kept, as that costs no more than starting a new run.
+        size_t start = word;
+        size_t header = runs.size();
+        runs.push_back(0);
+        while (word < WORDS) {
+            uint64_t diff = load_word(bytes, word) ^ ref_word(word);
+            if (diff == 0 && (word + 1 == WORDS || load_word(bytes, word + 1) == ref_word(word + 1)))
+                break;
+            runs.push_back(diff);
+            word++;
+        }
+        runs[header] = static_cast<uint64_t>(start - last_end) << 32 | (word - start);
+        last_end = word;
+    }
+}
+
+void Rewind::apply(const std::vector<uint64_t>& runs, SaveState& state) {
+    auto* bytes = reinterpret_cast<unsigned char*>(&state);
+    size_t word = 0;
+    size_t idx = 0;
+    while (idx < runs.size()) {
+        uint64_t header = runs[idx++];
+        word += header >> 32;
+        size_t length = header & 0xFFFFFFFF;
+        for (size_t end = word + length; word < end; word++)
+            store_word(bytes, word, load_word(bytes, word) ^ runs[idx++]);
+    }
+}
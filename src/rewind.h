@@ -0,0 +1,70 @@
+#pragma once
+
+#include "save_state.h"
+#include "utilities.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// History of recent frames for stepping backwards.
+//
+// Each frame is stored as its save state XORed against the previous
+//  frame's, run-length coded a word at a time: runs of unchanged words
+//  are skipped, so a frame that touched a few bytes of RAM and a sprite
+//  costs a few dozen bytes. Every KEYFRAME_INTERVAL frames a keyframe
+//  (coded against zero, which is most of memory) starts a new segment.
+//  Once the history is over its frame or byte limit, whole segments are
+//  dropped from the old end, so the oldest frame is always a keyframe.
+//
+// Stepping back XORs the newest delta into the newest state, which gives
+//  the frame before it; crossing back over a keyframe rebuilds the frame
+//  before from the previous segment's keyframe and deltas.
+class Rewind {
+    public:
+        explicit Rewind(size_t max_frames, size_t max_bytes = Utils::REWIND_MAX_BYTES,
+            uint32_t keyframe_interval = Utils::REWIND_KEYFRAME_INTERVAL);
+
+        // Capturing a frame: fill in next(), then capture() stores it as
+        //  the newest frame
+        SaveState& next() { return *next_; }
+        void capture();
+
+        // Drops the newest frame and returns the one before it, or nullptr
+        //  when there is nothing older. The state stays valid until the
+        //  next call.
+        const SaveState* step_back();
+
+        size_t frames() const { return frames_.size(); }
+        size_t bytes() const { return bytes_; }
+        void clear();
+
+    private:
+        static constexpr size_t WORDS = sizeof(SaveState) / sizeof(uint64_t);
+        static_assert(sizeof(SaveState) % sizeof(uint64_t) == 0, "Save states are coded a word at a time");
+
+        struct Frame {
+            bool keyframe;
+            std::vector<uint64_t> runs;     // Per run: skip << 32 | length, then `length` XORed words
+        };
+
+        const size_t max_frames_;
+        const size_t max_bytes_;
+        const uint32_t keyframe_interval_;
+
+        std::deque<Frame> frames_;          // Oldest first
+        size_t bytes_ = 0;
+        size_t keyframes_ = 0;
+        uint32_t since_keyframe_ = 0;       // Deltas captured since the newest keyframe
+        std::vector<uint64_t> scratch_;     // Encoder output, copied out at its final size
+
+        std::unique_ptr<SaveState> current_;    // The newest frame
+        std::unique_ptr<SaveState> next_;       // Being filled in for capture()
+
+        // reference == nullptr codes against all zeroes (keyframes)
+        static void encode(const SaveState& state, const SaveState* reference, std::vector<uint64_t>& runs);
+        static void apply(const std::vector<uint64_t>& runs, SaveState& state);
+        static size_t frame_bytes(const Frame& frame) { return frame.runs.capacity() * sizeof(uint64_t) + sizeof(Frame); }
+        void drop_oldest_segment();
+};
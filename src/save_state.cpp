@@ -0,0 +1,85 @@
+#include "save_state.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define CHIP8_MMAP 1
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#else
+    #define CHIP8_MMAP 0
+#endif
+
+void parse_state_spec(const std::string& spec, std::string& path, size_t& index) {
+    size_t colon = spec.rfind(':');
+    if (colon != std::string::npos && colon + 1 < spec.size() &&
+        spec.find_first_not_of("0123456789", colon + 1) == std::string::npos) {
+        path = spec.substr(0, colon);
+        index = std::stoull(spec.substr(colon + 1));
+    } else {
+        path = spec;
+        index = 0;
+    }
+}
+
+void write_state_file(const std::string& path, std::span<const SaveState> states) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out)
+        throw std::runtime_error("Failed to open state file " + path);
+
+    out.write(reinterpret_cast<const char*>(states.data()), states.size_bytes());
+    if (!out)
+        throw std::runtime_error("Failed to write state file " + path);
+}
+
+MappedStates::MappedStates(const std::string& path) {
+#if CHIP8_MMAP
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open state file " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to read state file " + path);
+    }
+    mapping_size_ = static_cast<size_t>(info.st_size);
+    if (mapping_size_ != 0) {
+        mapping_ = mmap(nullptr, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping_ == MAP_FAILED)
+            mapping_ = nullptr;
+    }
+    close(fd);
+    if (!mapping_)
+        throw std::runtime_error("Failed to map state file " + path);
+    states_ = static_cast<const SaveState*>(mapping_);
+    size_t bytes = mapping_size_;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in)
+        throw std::runtime_error("Failed to open state file " + path);
+    size_t bytes = static_cast<size_t>(in.tellg());
+    copy_.resize(bytes / sizeof(SaveState));
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(copy_.data()), copy_.size() * sizeof(SaveState));
+    states_ = copy_.data();
+#endif
+
+    count_ = bytes / sizeof(SaveState);
+    if (count_ == 0 || bytes % sizeof(SaveState) != 0 || !states_[0].valid()) {
+#if CHIP8_MMAP
+        munmap(mapping_, mapping_size_);
+#endif
+        throw std::runtime_error("Not a state file for this build: " + path);
+    }
+}
+
+MappedStates::~MappedStates() {
+#if CHIP8_MMAP
+    if (mapping_)
+        munmap(mapping_, mapping_size_);
+#endif
+}
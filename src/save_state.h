@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cpu.h"
+#include "peripherals.h"
+#include "quirks.h"
+#include "utilities.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// A snapshot of the whole machine. Each part is a plain struct copied in
+//  or out in one go (memory alone is one 64K memcpy), and the whole thing
+//  is trivially copyable, so a state file is just SaveStates back to back
+//  and can be mapped and restored from in place.
+struct SaveState {
+    static constexpr std::array<char, 4> MAGIC = {'C', '8', 'S', 'V'};
+    static constexpr uint32_t VERSION = 1;
+
+    // Checked before anything is restored. The size catches builds whose
+    //  layout differs (another memory size, or another standard library).
+    struct Header {
+        std::array<char, 4> magic = MAGIC;
+        uint32_t version = VERSION;
+        uint32_t size = 0;
+        Profile profile = Profile::Modern;
+    };
+
+    Header header;
+    uint64_t frame;             // Emulator frames and cycles so far
+    uint64_t cycles;
+    uint64_t timer_ticks;       // TimerClock
+    uint8_t delay_timer;
+    uint8_t sound_timer;
+    CPU::State cpu;
+    Peripherals::State peripherals;
+    std::array<uint8_t, Utils::MEMORY_SIZE> ram;     // Fixed size for the mapped format; zero past 4K for classic profiles
+
+    bool valid() const {
+        return header.magic == MAGIC && header.version == VERSION && header.size == sizeof(SaveState);
+    }
+};
+static_assert(std::is_trivially_copyable_v<SaveState>, "Save states are copied and mapped as raw bytes");
+
+// Splits "file" or "file:N" (the Nth state in the file, from 0)
+void parse_state_spec(const std::string& spec, std::string& path, size_t& index);
+
+// Writes states back to back, ready for MappedStates
+void write_state_file(const std::string& path, std::span<const SaveState> states);
+
+// A state file mapped read-only into memory, so restoring any of
+//  thousands of checkpoints reads straight from the page cache rather
+//  than through a stream. Hosts without mmap read the file in instead.
+class MappedStates {
+    public:
+        explicit MappedStates(const std::string& path);    // Throws std::runtime_error
+        ~MappedStates();
+
+        MappedStates(const MappedStates&) = delete;
+        MappedStates& operator=(const MappedStates&) = delete;
+
+        size_t size() const { return count_; }
+        const SaveState& operator[](size_t index) const { return states_[index]; }
+
+    private:
+        const SaveState* states_ = nullptr;
+        size_t count_ = 0;
+        void* mapping_ = nullptr;
+        size_t mapping_size_ = 0;
+        std::vector<SaveState> copy_;   // Without mmap
+};
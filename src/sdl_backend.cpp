@@ -0,0 +1,359 @@
+#include "sdl_backend.h"
+#include "peripherals.h"
+#include "utilities.h"
+#include "print.h"
+#include "telemetry.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <format>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+    // Keyboard keys standing in for the CHIP-8 keypad
+    const std::unordered_map<SDL_Keycode, uint8_t> KEY_MAPPING = {
+        {SDLK_1, 0x1}, {SDLK_2, 0x2}, {SDLK_3, 0x3}, {SDLK_4, 0xC},
+        {SDLK_q, 0x4}, {SDLK_w, 0x5}, {SDLK_e, 0x6}, {SDLK_r, 0xD},
+        {SDLK_a, 0x7}, {SDLK_s, 0x8}, {SDLK_d, 0x9}, {SDLK_f, 0xE},
+        {SDLK_z, 0xA}, {SDLK_x, 0x0}, {SDLK_c, 0xB}, {SDLK_v, 0xF} 
+    };
+
+    // 3x5 pixel font for the stats overlay, one row of three bits per byte
+    constexpr char OVERLAY_CHARS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ.:%/-";
+    constexpr uint8_t OVERLAY_FONT[][5] = {
+        {7, 5, 5, 5, 7}, {2, 6, 2, 2, 7}, {7, 1, 7, 4, 7}, {7, 1, 7, 1, 7}, {5, 5, 7, 1, 1},
+        {7, 4, 7, 1, 7}, {7, 4, 7, 5, 7}, {7, 1, 1, 1, 1}, {7, 5, 7, 5, 7}, {7, 5, 7, 1, 7},
+        {2, 5, 7, 5, 5}, {6, 5, 6, 5, 6}, {3, 4, 4, 4, 3}, {6, 5, 5, 5, 6}, {7, 4, 6, 4, 7},
+        {7, 4, 6, 4, 4}, {3, 4, 5, 5, 3}, {5, 5, 7, 5, 5}, {7, 2, 2, 2, 7}, {1, 1, 1, 5, 2},
+        {5, 5, 6, 5, 5}, {4, 4, 4, 4, 7}, {5, 7, 7, 5, 5}, {6, 5, 5, 5, 5}, {2, 5, 5, 5, 2},
+        {6, 5, 6, 4, 4}, {2, 5, 5, 6, 3}, {6, 5, 6, 5, 5}, {3, 4, 2, 1, 6}, {7, 2, 2, 2, 2},
+        {5, 5, 5, 5, 7}, {5, 5, 5, 5, 2}, {5, 5, 7, 7, 5}, {5, 5, 2, 5, 5}, {5, 5, 2, 2, 2},
+        {7, 1, 2, 4, 7}, {0, 0, 0, 0, 2}, {0, 2, 0, 2, 0}, {5, 1, 2, 4, 5}, {1, 1, 2, 4, 4},
+        {0, 0, 7, 0, 0},
+    };
+    static_assert(std::size(OVERLAY_FONT) == sizeof(OVERLAY_CHARS) - 1);
+
+    constexpr int OVERLAY_SCALE = 2;    // Screen pixels per font pixel
+    constexpr int OVERLAY_MARGIN = 4;   // Font pixels around the text
+}
+
+SdlBackend::SdlBackend() {
+    sdl_init();
+}
+
+SdlBackend::~SdlBackend() {
+    sdl_cleanup();
+}
+
+/*
+    SDL Management Functions
+*/
+
+void SdlBackend::sdl_init() {
+
+    // Initialize SDL
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+        throw std::runtime_error(std::format("Failed to initialize SDL: %s\n", SDL_GetError()));
+
+    // Create the SDL window
+    window_ = SDL_CreateWindow(
+        Utils::WINDOW_TITLE,
+        SDL_WINDOWPOS_UNDEFINED,
+        SDL_WINDOWPOS_UNDEFINED,
+        Utils::WINDOW_WIDTH,
+        Utils::WINDOW_HEIGHT,
+        SDL_WINDOW_SHOWN);
+    if (!window_)
+        throw std::runtime_error(std::format("Failed to create SDL window: %s\n", SDL_GetError()));
+
+    // Create the SDL renderer
+    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    if (!renderer_)
+        throw std::runtime_error(std::format("Failed to create SDL renderer: %s\n", SDL_GetError()));
+
+    // Create the SDL texture, sized for hires (lores pixels are drawn 2x2)
+    texture_ = SDL_CreateTexture(
+        renderer_, 
+        SDL_PIXELFORMAT_RGBA8888,
+        SDL_TEXTUREACCESS_STREAMING,
+        Utils::HIRES_WIDTH,
+        Utils::HIRES_HEIGHT
+    );
+    if (!texture_)
+        throw std::runtime_error(std::format("Failed to create SDL texture: %s\n", SDL_GetError()));
+
+    // Set up the SDL Audio
+    SDL_AudioSpec desired, obtained;
+    desired.freq = Utils::AUDIO_RATE_HZ;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 1;
+    desired.samples = Utils::AUDIO_BUFFER_SIZE;
+    desired.callback = audio_callback;
+    desired.userdata = &audio_;
+    audio_device_ = SDL_OpenAudioDevice(nullptr, 0, &desired, &obtained, 0);
+    if (!audio_device_)
+        throw std::runtime_error(std::format("Failed to create SDL audio: %s\n", SDL_GetError()));
+
+    // The device runs for good; silence is rendered rather than paused for
+    SDL_PauseAudioDevice(audio_device_, 0);
+}
+
+void SdlBackend::sdl_cleanup() {
+    if (audio_device_) {
+        SDL_CloseAudioDevice(audio_device_);
+        audio_device_ = 0;
+    }
+
+    if (texture_) {
+        SDL_DestroyTexture(texture_);
+        texture_ = nullptr;
+    }
+    
+    if (renderer_) {
+        SDL_DestroyRenderer(renderer_);
+        renderer_ = nullptr;
+    }
+
+    if (window_) {
+        SDL_DestroyWindow(window_);
+        window_ = nullptr;
+    }
+
+    SDL_Quit();
+}
+
+/*
+    Display Management Functions
+*/
+void SdlBackend::present(const Framebuffer& pixels) {
+    // Emulation thread: hand the frame over, the UI thread draws it
+    Frame& frame = frames_.back();
+    frame.pixels = pixels;
+    frame.input_tick = pending_input_tick_;
+    pending_input_tick_ = 0;
+    bool dropped = frames_.publish();
+    if (telemetry_)
+        telemetry_->present(dropped);
+
+    // If the UI never took the frame this replaced, the key press it was
+    //  to show is timed to the next one instead, so the sample errs late
+    //  rather than going missing
+    if (dropped)
+        pending_input_tick_ = frames_.back().input_tick;
+}
+
+void SdlBackend::draw(const Frame& frame, bool fresh) {
+    uint64_t start = ticks();
+
+    // Expand the packed planes to RGBA straight into the SDL texture
+    void* texture_pixels = nullptr;
+    int pitch = 0;
+    if (SDL_LockTexture(texture_, nullptr, &texture_pixels, &pitch) == 0) {
+        frame.pixels.to_rgba(texture_pixels, pitch);
+        SDL_UnlockTexture(texture_);
+    }
+
+    // Copy the texture to the renderer and present
+    SDL_RenderCopy(renderer_, texture_, nullptr, nullptr);
+    if (overlay_)
+        draw_overlay();
+    SDL_RenderPresent(renderer_);
+
+    uint64_t now = ticks();
+    overlay_tick_ = now;
+    if (telemetry_) {
+        telemetry_->record(Telemetry::Timing::Render, now - start);
+        if (fresh && frame.input_tick)
+            telemetry_->record(Telemetry::Timing::InputToDisplay, now - frame.input_tick);
+    }
+}
+
+void SdlBackend::draw_overlay() {
+    if (!telemetry_)
+        return;
+
+    // Milliseconds at the median, 99th percentile and worst, then counters
+    char lines[Telemetry::TIMING_COUNT + 2][48];
+    static constexpr const char* LABELS[Telemetry::TIMING_COUNT] = {"EMU", "DRAW", "SLEEP", "INPUT"};
+    std::snprintf(lines[0], sizeof(lines[0]), "%-6s%7s%7s%7s", "MS", "P50", "P99", "MAX");
+    for (size_t idx = 0; idx < Telemetry::TIMING_COUNT; idx++) {
+        const Histogram& histogram = telemetry_->histogram(static_cast<Telemetry::Timing>(idx));
+        std::snprintf(lines[idx + 1], sizeof(lines[idx + 1]), "%-6s%7.2f%7.2f%7.2f", LABELS[idx],
+            histogram.percentile(0.5) / 1e6, histogram.percentile(0.99) / 1e6, histogram.max() / 1e6);
+    }
+    std::snprintf(lines[Telemetry::TIMING_COUNT + 1], sizeof(lines[0]), "FRAMES %llu LATE %llu DROPPED %llu",
+        static_cast<unsigned long long>(telemetry_->frames()),
+        static_cast<unsigned long long>(telemetry_->late_frames()),
+        static_cast<unsigned long long>(telemetry_->dropped_presents()));
+
+    // Text as one batch of filled squares over a darkened box
+    std::vector<SDL_Rect> pixels;
+    size_t columns = 0;
+    for (size_t row = 0; row < std::size(lines); row++) {
+        size_t length = std::strlen(lines[row]);
+        columns = std::max(columns, length);
+        for (size_t column = 0; column < length; column++) {
+            const char* found = std::strchr(OVERLAY_CHARS, std::toupper(static_cast<unsigned char>(lines[row][column])));
+            if (!found || *found == '\0')
+                continue;
+            const uint8_t* glyph = OVERLAY_FONT[found - OVERLAY_CHARS];
+            for (int y = 0; y < 5; y++) {
+                for (int x = 0; x < 3; x++) {
+                    if (glyph[y] & (4 >> x)) {
+                        pixels.push_back(SDL_Rect{
+                            (OVERLAY_MARGIN + static_cast<int>(column) * 4 + x) * OVERLAY_SCALE,
+                            (OVERLAY_MARGIN + static_cast<int>(row) * 6 + y) * OVERLAY_SCALE,
+                            OVERLAY_SCALE, OVERLAY_SCALE});
+                    }
+                }
+            }
+        }
+    }
+
+    SDL_Rect box = {0, 0, (2 * OVERLAY_MARGIN + static_cast<int>(columns) * 4 - 1) * OVERLAY_SCALE,
+        (2 * OVERLAY_MARGIN + static_cast<int>(std::size(lines)) * 6 - 1) * OVERLAY_SCALE};
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 176);
+    SDL_RenderFillRect(renderer_, &box);
+    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+    SDL_RenderFillRects(renderer_, pixels.data(), static_cast<int>(pixels.size()));
+}
+
+/*
+    Sound Management Functions
+*/
+void SdlBackend::audio_callback(void *userdata, Uint8 *stream, int len) {
+    // Runs on SDL's audio thread; the stream holds 16-bit mono samples
+    Audio* audio = static_cast<Audio*>(userdata);
+    audio->render(reinterpret_cast<int16_t*>(stream), static_cast<size_t>(len) / sizeof(int16_t));
+}
+
+/*
+    UI Thread
+*/
+void SdlBackend::run_ui(const std::atomic<bool>& finished) {
+    while (!finished.load(std::memory_order_acquire)) {
+        SDL_Event event;
+        if (SDL_WaitEventTimeout(&event, static_cast<int>(UI_POLL_MS))) {
+            do {
+                handle_event(event);
+            } while (SDL_PollEvent(&event));
+        }
+
+        // The overlay keeps updating while the program shows nothing new,
+        //  and toggling it redraws right away
+        if (frames_.take()) {
+            draw(frames_.front(), true);
+        } else if (overlay_tick_ == 0 || (overlay_ && ticks() - overlay_tick_ >= Utils::OVERLAY_REFRESH_MS * tick_frequency() / 1000)) {
+            draw(frames_.front(), false);
+        }
+    }
+}
+
+void SdlBackend::handle_event(const SDL_Event& event) {
+    switch (event.type) {
+        case SDL_QUIT: 
+        {
+            quit_.store(true, std::memory_order_release);
+            wake_input();
+            break;
+        }
+        case SDL_KEYDOWN:
+        {
+            // Handle key press
+            if (event.key.repeat == 0) {
+                auto key_iter = KEY_MAPPING.find(event.key.keysym.sym);
+                if (key_iter != KEY_MAPPING.end()) {
+                    uint16_t bit = static_cast<uint16_t>(1u << key_iter->second);
+                    uint64_t expected = 0;
+                    key_tick_.compare_exchange_strong(expected, ticks(), std::memory_order_relaxed);
+                    keys_down_.fetch_or(bit, std::memory_order_release);
+                    keys_pressed_.fetch_or(bit, std::memory_order_release);
+                    wake_input();
+                }
+
+                // F1-F4 pick the emulation speed
+                switch (event.key.keysym.sym) {
+                    case SDLK_F1: requested_speed_.store(static_cast<int>(Speed::Normal)); break;
+                    case SDLK_F2: requested_speed_.store(static_cast<int>(Speed::Double)); break;
+                    case SDLK_F3: requested_speed_.store(static_cast<int>(Speed::Unthrottled)); break;
+                    case SDLK_F4: requested_speed_.store(static_cast<int>(Speed::SlowMotion)); break;
+                    case SDLK_BACKSPACE: rewind_held_.store(true, std::memory_order_relaxed); break;
+                    case SDLK_F5: overlay_ = !overlay_; overlay_tick_ = 0; break;
+                    default: break;
+                }
+            }
+            break;
+        }
+        case SDL_KEYUP:
+        {
+            // Handle key release
+            auto key_iter = KEY_MAPPING.find(event.key.keysym.sym);
+            if (key_iter != KEY_MAPPING.end()) {
+                keys_down_.fetch_and(static_cast<uint16_t>(~(1u << key_iter->second)), std::memory_order_release);
+            }
+            if (event.key.keysym.sym == SDLK_BACKSPACE)
+                rewind_held_.store(false, std::memory_order_relaxed);
+            break;
+        }
+        default: 
+            break;
+    }
+}
+
+void SdlBackend::wake_input() {
+    // Taking the lock keeps this from landing between wait_input's check
+    //  and its sleep
+    { std::lock_guard<std::mutex> lock(input_mutex_); }
+    input_wake_.notify_all();
+}
+
+/*
+    User IO Functions (emulation thread)
+*/
+bool SdlBackend::poll_input(uint64_t, Peripherals& peripherals) {
+    uint16_t pressed = keys_pressed_.exchange(0, std::memory_order_acquire);
+    uint16_t down = keys_down_.load(std::memory_order_acquire);
+
+    // Timed until the next frame reaches the screen
+    if (pressed) {
+        uint64_t key_tick = key_tick_.exchange(0, std::memory_order_relaxed);
+        if (key_tick && !pending_input_tick_)
+            pending_input_tick_ = key_tick;
+    }
+
+    // Presses first, then releases: a key tapped between two polls still
+    //  reaches the program as a press
+    for (uint8_t key = 0; key < 16; key++) {
+        uint16_t bit = static_cast<uint16_t>(1u << key);
+        if ((pressed & bit) || ((down & bit) && !(delivered_keys_ & bit)))
+            peripherals.key_event(key, true);
+        if (!(down & bit) && ((delivered_keys_ | pressed) & bit))
+            peripherals.key_event(key, false);
+    }
+    delivered_keys_ = down;
+
+    return quit_.load(std::memory_order_acquire);
+}
+
+bool SdlBackend::wait_input(uint32_t ms) {
+    // The event queue belongs to the UI thread, so sleep until it reports a
+    //  key press (left in place for the next poll_input) or quit
+    std::unique_lock<std::mutex> lock(input_mutex_);
+    return input_wake_.wait_for(lock, std::chrono::milliseconds(ms), [this] {
+        return keys_pressed_.load(std::memory_order_acquire) != 0 || quit_.load(std::memory_order_acquire);
+    });
+}
+
+bool SdlBackend::take_speed_request(Speed& speed) {
+    int requested = requested_speed_.exchange(-1, std::memory_order_relaxed);
+    if (requested < 0)
+        return false;
+    speed = static_cast<Speed>(requested);
+    return true;
+}
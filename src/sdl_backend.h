@@ -0,0 +1,92 @@
+#pragma once
+
+#include "audio.h"
+#include "backend.h"
+#include "triple_buffer.h"
+#include <SDL2/SDL.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Window, audio device and keyboard through SDL2.
+//
+// The window, renderer and event pump belong to the UI thread (run_ui).
+//  The emulation thread only hands frames over through a triple buffer
+//  and reads keys, quit and speed requests from atomics, so a slow or
+//  vsync-blocked present never holds up instructions.
+class SdlBackend : public Backend {
+    public:
+        SdlBackend();
+        ~SdlBackend() override;
+
+        SdlBackend(const SdlBackend&) = delete;
+        SdlBackend& operator=(const SdlBackend&) = delete;
+
+        // Emulation thread
+        void present(const Framebuffer& pixels) override;
+        void beep(uint64_t frame, bool enable) override { audio_.beep(frame, enable); }
+        void audio_pattern(uint64_t frame, const AudioPattern& pattern, uint8_t pitch) override { audio_.pattern(frame, pattern, pitch); }
+        bool poll_input(uint64_t frame, Peripherals& peripherals) override;
+        void keys_restored(uint16_t keys) override { delivered_keys_ = keys; }
+        bool take_speed_request(Speed& speed) override;
+        bool rewind_held() const override { return rewind_held_.load(std::memory_order_relaxed); }
+
+        bool real_time() const override { return true; }
+        uint64_t ticks() const override { return SDL_GetPerformanceCounter(); }
+        uint64_t tick_frequency() const override { return SDL_GetPerformanceFrequency(); }
+        void delay(uint32_t ms) override { SDL_Delay(ms); }
+        bool wait_input(uint32_t ms) override;
+        bool audio_lead(uint64_t frame, int64_t& samples) const override { return audio_.lead(frame, samples); }
+        void set_telemetry(Telemetry* telemetry) override { telemetry_ = telemetry; }
+
+        // UI thread
+        bool runs_ui() const override { return true; }
+        void run_ui(const std::atomic<bool>& finished) override;
+
+    private:
+        static constexpr uint32_t UI_POLL_MS = 1;   // Longest the UI sleeps before checking for a frame
+
+        // SDL objects and helpers (UI thread)
+        SDL_Window* window_ = nullptr;
+        SDL_Renderer* renderer_ = nullptr;
+        SDL_Texture* texture_ = nullptr;
+        SDL_AudioDeviceID audio_device_ = 0;
+        Audio audio_;   // Shared with the audio callback thread
+
+        // Emulation -> UI
+        struct Frame {
+            Framebuffer pixels = {};
+            uint64_t input_tick = 0;    // Oldest key press this frame is the first to show, or 0
+        };
+        TripleBuffer<Frame> frames_;
+
+        // UI -> emulation
+        std::atomic<uint16_t> keys_down_{0};        // One bit per CHIP-8 key
+        std::atomic<uint16_t> keys_pressed_{0};     // Presses since the last poll, so taps aren't lost
+        std::atomic<uint64_t> key_tick_{0};         // When the oldest undelivered press happened
+        std::atomic<bool> quit_{false};
+        std::atomic<int> requested_speed_{-1};      // Speed, or -1 for none
+        std::atomic<bool> rewind_held_{false};
+        std::mutex input_mutex_;                    // Lets wait_input sleep until a press or quit
+        std::condition_variable input_wake_;
+
+        // Emulation thread's view of the keys
+        uint16_t delivered_keys_ = 0;
+        uint64_t pending_input_tick_ = 0;   // Key press delivered but not shown yet
+
+        // Stats overlay (UI thread), toggled with F5
+        Telemetry* telemetry_ = nullptr;
+        bool overlay_ = false;
+        uint64_t overlay_tick_ = 0;     // Last redraw
+
+        void sdl_init();    // Initialize SDL display and audio
+        void sdl_cleanup(); // De-init SDL display and audio
+
+        void handle_event(const SDL_Event& event);
+        void wake_input();
+        void draw(const Frame& frame, bool fresh);
+        void draw_overlay();
+
+        // Audio functions
+        static void audio_callback(void *userdata, Uint8 *stream, int len);
+};
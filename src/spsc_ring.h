@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Fixed-size queue between exactly one producer thread and one consumer
+//  thread. Neither side ever blocks or takes a lock: each owns one index
+//  and only reads the other's.
+template <typename T, size_t N>
+class SpscRing {
+    public:
+        static_assert(N != 0 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+        // Producer side, returns false if the ring is full
+        bool push(const T& item) {
+            size_t head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) == N)
+                return false;
+            items_[head & (N - 1)] = item;
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer side: oldest item or nullptr if empty, valid until pop()
+        const T* peek() const {
+            size_t tail = tail_.load(std::memory_order_relaxed);
+            if (tail == head_.load(std::memory_order_acquire))
+                return nullptr;
+            return &items_[tail & (N - 1)];
+        }
+
+        void pop() {
+            tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+    private:
+        std::array<T, N> items_{};
+        alignas(64) std::atomic<size_t> head_{0};   // Next slot to write (producer)
+        alignas(64) std::atomic<size_t> tail_{0};   // Next slot to read (consumer)
+};
@@ -0,0 +1,177 @@
+#include "telemetry.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    const char* timing_help(Telemetry::Timing timing) {
+        switch (timing) {
+            case Telemetry::Timing::Emulation:      return "Time spent running each frame's instructions";
+            case Telemetry::Timing::Render:         return "Time spent expanding, uploading and presenting each frame";
+            case Telemetry::Timing::SleepOvershoot: return "How far past the frame deadline pacing woke up";
+            case Telemetry::Timing::InputToDisplay: return "Time from a key press to the next frame on screen";
+        }
+        return "";
+    }
+
+    // Exported bucket bounds: each power of two from about 1 us up
+    constexpr unsigned EXPORT_FIRST_OCTAVE = 10;
+    constexpr unsigned EXPORT_LAST_OCTAVE = 32;
+}
+
+/*
+    Histogram
+*/
+void Histogram::record(uint64_t ns) {
+    buckets_[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = max_.load(std::memory_order_relaxed);
+    while (ns > seen && !max_.compare_exchange_weak(seen, ns, std::memory_order_relaxed)) {}
+}
+
+size_t Histogram::bucket_index(uint64_t ns) {
+    if (ns < SUB_BUCKETS)
+        return static_cast<size_t>(ns);
+
+    // The top bit picks the power of two, the two below it the quarter
+    unsigned octave = static_cast<unsigned>(std::bit_width(ns)) - 1;
+    size_t index = SUB_BUCKETS * (octave - 1) + ((ns >> (octave - 2)) & (SUB_BUCKETS - 1));
+    return std::min(index, BUCKETS - 1);
+}
+
+uint64_t Histogram::bucket_limit(size_t index) {
+    if (index < SUB_BUCKETS)
+        return index + 1;
+    if (index >= BUCKETS - 1)
+        return std::numeric_limits<uint64_t>::max();
+    size_t octave = index / SUB_BUCKETS + 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS + 1) << (octave - 2);
+}
+
+uint64_t Histogram::percentile(double p) const {
+    // Buckets are read one at a time while others may still be recording,
+    //  so count from the buckets themselves rather than count_
+    std::array<uint64_t, BUCKETS> counts;
+    uint64_t total = 0;
+    for (size_t index = 0; index < BUCKETS; index++) {
+        counts[index] = bucket(index);
+        total += counts[index];
+    }
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(p * static_cast<double>(total))));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BUCKETS; index++) {
+        seen += counts[index];
+        if (seen >= rank)
+            return std::min(bucket_limit(index), max());
+    }
+    return max();
+}
+
+/*
+    Telemetry
+*/
+Telemetry::Telemetry(uint64_t tick_frequency)
+    : ns_per_tick_(1e9 / static_cast<double>(tick_frequency)) {}
+
+Telemetry::~Telemetry() {
+    if (!exporter_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(export_mutex_);
+        export_stop_ = true;
+    }
+    export_wake_.notify_all();
+    exporter_.join();
+
+    // One last time, so the file covers the whole run
+    export_file();
+}
+
+const char* Telemetry::timing_name(Timing timing) {
+    switch (timing) {
+        case Timing::Emulation:      return "emulation";
+        case Timing::Render:         return "render";
+        case Timing::SleepOvershoot: return "sleep_overshoot";
+        case Timing::InputToDisplay: return "input_to_display";
+    }
+    return "";
+}
+
+void Telemetry::write_prometheus(std::ostream& out) const {
+    for (size_t idx = 0; idx < TIMING_COUNT; idx++) {
+        Timing timing = static_cast<Timing>(idx);
+        const Histogram& histogram = histograms_[idx];
+        std::string name = std::string("chip8_") + timing_name(timing) + "_seconds";
+        out << "# HELP " << name << " " << timing_help(timing) << "\n";
+        out << "# TYPE " << name << " histogram\n";
+
+        // Bucket counts are cumulative; each bound is the start of one of
+        //  the histogram's powers of two, so the counts are exact
+        std::array<uint64_t, Histogram::BUCKETS> counts;
+        uint64_t total = 0;
+        for (size_t index = 0; index < Histogram::BUCKETS; index++) {
+            counts[index] = histogram.bucket(index);
+            total += counts[index];
+        }
+        uint64_t below = 0;
+        size_t index = 0;
+        for (unsigned octave = EXPORT_FIRST_OCTAVE; octave <= EXPORT_LAST_OCTAVE; octave++) {
+            for (; index < Histogram::SUB_BUCKETS * (octave - 1); index++)
+                below += counts[index];
+            char bound[32];
+            std::snprintf(bound, sizeof(bound), "%.9g", std::ldexp(1.0, static_cast<int>(octave)) * 1e-9);
+            out << name << "_bucket{le=\"" << bound << "\"} " << below << "\n";
+        }
+        out << name << "_bucket{le=\"+Inf\"} " << total << "\n";
+
+        char sum[32];
+        std::snprintf(sum, sizeof(sum), "%.9g", static_cast<double>(histogram.sum()) * 1e-9);
+        out << name << "_sum " << sum << "\n";
+        out << name << "_count " << total << "\n";
+    }
+
+    auto counter = [&out](const char* name, const char* help, uint64_t value) {
+        out << "# HELP " << name << " " << help << "\n";
+        out << "# TYPE " << name << " counter\n";
+        out << name << " " << value << "\n";
+    };
+    counter("chip8_frames_total", "Frames run in real time", frames());
+    counter("chip8_late_frames_total", "Frames that finished after their deadline", late_frames());
+    counter("chip8_presents_total", "Frames handed to the display", presents());
+    counter("chip8_dropped_presents_total", "Frames replaced by a newer one before reaching the screen", dropped_presents());
+}
+
+void Telemetry::start_export(const std::string& path, uint32_t interval_seconds) {
+    export_path_ = path;
+    if (!export_file())
+        throw std::runtime_error("Failed to write stats file " + path);
+
+    exporter_ = std::thread([this, interval_seconds] {
+        std::unique_lock<std::mutex> lock(export_mutex_);
+        while (!export_wake_.wait_for(lock, std::chrono::seconds(interval_seconds), [this] { return export_stop_; }))
+            export_file();
+    });
+}
+
+bool Telemetry::export_file() const {
+    std::string temp_path = export_path_ + ".tmp";
+    {
+        std::ofstream out(temp_path, std::ios::trunc);
+        if (!out)
+            return false;
+        write_prometheus(out);
+        if (!out)
+            return false;
+    }
+    return std::rename(temp_path.c_str(), export_path_.c_str()) == 0;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Distribution of durations in nanoseconds, in fixed log-linear buckets:
+//  every power of two is split into four, so any value lands in a bucket
+//  within 25% of it. Recording is a few relaxed atomic adds, so one
+//  thread can record while others read without locks.
+class Histogram {
+    public:
+        static constexpr size_t SUB_BUCKETS = 4;    // Per power of two
+        static constexpr size_t BUCKETS = 128;      // Up to about 7 s, then one overflow bucket
+
+        void record(uint64_t ns);
+
+        uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+        uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+        uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+        uint64_t bucket(size_t index) const { return buckets_[index].load(std::memory_order_relaxed); }
+
+        // Upper bound of the bucket holding the pth fraction of values
+        //  (0.5 = median), or 0 if nothing was recorded
+        uint64_t percentile(double p) const;
+
+        static size_t bucket_index(uint64_t ns);
+        static uint64_t bucket_limit(size_t index);     // Exclusive upper bound
+
+    private:
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> max_{0};
+};
+
+// Host-side timing of real-time runs, always on: how long frames take to
+//  emulate and to draw, how far sleeps overshoot, how long a key press
+//  takes to reach the screen, and how many frames ran late or were never
+//  shown. The emulation and UI threads record; the stats overlay and the
+//  exporter read.
+//
+// The exporter rewrites a file in Prometheus' text format every interval
+//  (and once more on shutdown), through a temporary file and a rename so
+//  readers like node_exporter's textfile collector never see half of one.
+class Telemetry {
+    public:
+        enum class Timing {
+            Emulation,      // Running one frame's instructions and ending it
+            Render,         // Expanding, uploading and presenting a frame
+            SleepOvershoot, // Past the frame deadline when pacing woke up
+            InputToDisplay, // Key press to the next frame on screen
+        };
+        static constexpr size_t TIMING_COUNT = 4;
+
+        explicit Telemetry(uint64_t tick_frequency);
+        ~Telemetry();
+
+        Telemetry(const Telemetry&) = delete;
+        Telemetry& operator=(const Telemetry&) = delete;
+
+        // Durations come in the backend's clock ticks
+        void record(Timing timing, uint64_t ticks) {
+            histograms_[static_cast<size_t>(timing)].record(static_cast<uint64_t>(ticks * ns_per_tick_));
+        }
+        void frame(bool late) {
+            frames_.fetch_add(1, std::memory_order_relaxed);
+            if (late)
+                late_frames_.fetch_add(1, std::memory_order_relaxed);
+        }
+        void present(bool dropped) {
+            presents_.fetch_add(1, std::memory_order_relaxed);
+            if (dropped)
+                dropped_presents_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const Histogram& histogram(Timing timing) const { return histograms_[static_cast<size_t>(timing)]; }
+        uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+        uint64_t late_frames() const { return late_frames_.load(std::memory_order_relaxed); }
+        uint64_t presents() const { return presents_.load(std::memory_order_relaxed); }
+        uint64_t dropped_presents() const { return dropped_presents_.load(std::memory_order_relaxed); }
+
+        static const char* timing_name(Timing timing);
+
+        // Prometheus text exposition of everything above
+        void write_prometheus(std::ostream& out) const;
+
+        // Rewrite `path` every interval from a thread of its own. Throws
+        //  std::runtime_error if the file can't be written the first time.
+        void start_export(const std::string& path, uint32_t interval_seconds);
+
+    private:
+        const double ns_per_tick_;
+        std::array<Histogram, TIMING_COUNT> histograms_;
+        std::atomic<uint64_t> frames_{0};
+        std::atomic<uint64_t> late_frames_{0};
+        std::atomic<uint64_t> presents_{0};
+        std::atomic<uint64_t> dropped_presents_{0};
+
+        // Exporter
+        std::string export_path_;
+        std::thread exporter_;
+        std::mutex export_mutex_;
+        std::condition_variable export_wake_;
+        bool export_stop_ = false;
+
+        bool export_file() const;
+};
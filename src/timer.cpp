@@ -1,21 +1,23 @@
 #include "timer.h"
 
 
-Timer::Timer() {}
+Timer::Timer(const TimerClock& clock) : clock_(clock) {}
 
 void Timer::set(uint8_t timer_val) {
-    timer_val_ = timer_val;
+    set_val_ = timer_val;
+    set_tick_ = clock_.now();
 }
 
-uint8_t Timer::get() {
-    return timer_val_;
+uint8_t Timer::get() const {
+    // Counts down one per tick since it was set, stopping at zero
+    return static_cast<uint8_t>(ticks_until_expiry());
 }
 
-void Timer::tick() {
-    if (timer_val_ > 0)
-        timer_val_--;
+bool Timer::in_timeout() const {
+    return ticks_until_expiry() == 0;
 }
 
-bool Timer::in_timeout() {
-    return timer_val_ == 0;
-}
\ No newline at end of file
+uint64_t Timer::ticks_until_expiry() const {
+    uint64_t elapsed = clock_.now() - set_tick_;
+    return elapsed < set_val_ ? set_val_ - elapsed : 0;
+}
@@ -2,15 +2,29 @@
 
 #include <cstdint>
 
+// Count of 60 Hz timer ticks since start. The emulator advances it once
+//  per frame; timers are stamped against it rather than ticked one by one.
+class TimerClock {
+    public:
+        uint64_t now() const { return ticks_; }
+        void advance(uint64_t ticks = 1) { ticks_ += ticks; }
+        void restore(uint64_t ticks) { ticks_ = ticks; }    // Save states
+
+    private:
+        uint64_t ticks_ = 0;
+};
+
 class Timer {
     public: 
-        Timer();
+        explicit Timer(const TimerClock& clock);
 
         void set(uint8_t timer_val);
-        uint8_t get();
-        void tick();
-        bool in_timeout();
+        uint8_t get() const;
+        bool in_timeout() const;
+        uint64_t ticks_until_expiry() const;   // 0 once the timer has run out
 
     private:
-        uint8_t timer_val_ = 0;
+        const TimerClock& clock_;
+        uint8_t set_val_ = 0;       // Value last written
+        uint64_t set_tick_ = 0;     // Clock tick it was written at
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Hands the latest value from one writer thread to one reader thread.
+//  The writer always has a slot to fill and the reader always has a slot
+//  to read, so neither ever waits on the other; values the reader didn't
+//  get to in time are simply replaced by newer ones.
+template <typename T>
+class TripleBuffer {
+    public:
+        // Writer side: fill back(), then publish() it. Returns true if
+        //  that replaced a value the reader never took, which is then back
+        //  in back() until it is overwritten.
+        T& back() { return slots_[back_]; }
+        bool publish() {
+            uint8_t replaced = shared_.exchange(back_ | FRESH, std::memory_order_acq_rel);
+            back_ = replaced & INDEX;
+            return (replaced & FRESH) != 0;
+        }
+
+        // Reader side: true if a newer value was taken into front()
+        bool take() {
+            if (!(shared_.load(std::memory_order_relaxed) & FRESH))
+                return false;
+            front_ = shared_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+            return true;
+        }
+        const T& front() const { return slots_[front_]; }
+
+    private:
+        static constexpr uint8_t INDEX = 0x3;
+        static constexpr uint8_t FRESH = 0x4;   // Set while the shared slot holds an unread value
+
+        std::array<T, 3> slots_{};
+        uint8_t back_ = 0;                      // Writer's slot
+        uint8_t front_ = 1;                     // Reader's slot
+        alignas(64) std::atomic<uint8_t> shared_{2};   // Slot in between, plus FRESH
+};
@@ -1,27 +1,56 @@
 #pragma once
 
 #include <cstddef>
-#include <SDL2/SDL.h>
-#include <unordered_map>
+#include <cstdint>
 
 namespace Utils
 {
     // Helper funcs
-    constexpr uint32_t sdlcolor_to_uint32(SDL_Color color) {
-        return (color.r<<24) | (color.g<<16) | (color.b<<8) | color.a;
+    constexpr uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) {
+        return (uint32_t{r}<<24) | (uint32_t{g}<<16) | (uint32_t{b}<<8) | a;
+    }
+
+    // FNV-1a hash, used to match ROM images
+    constexpr uint32_t fnv1a(const uint8_t* data, size_t length) {
+        uint32_t hash = 2166136261u;
+        for (size_t idx = 0; idx < length; idx++) {
+            hash = (hash ^ data[idx]) * 16777619u;
+        }
+        return hash;
     }
     
     // Constants for display
     constexpr const char* WINDOW_TITLE = "Chip-8 Emulator";
 
-    constexpr SDL_Color PIXEL_COLOR_ON = {97, 184, 174, 255}; // light
-    constexpr SDL_Color PIXEL_COLOR_OFF = {19, 23, 38, 255};  // dark
+    // Colors are RGBA8888, the layout of the SDL texture they end up in
+    constexpr uint32_t PIXEL_ON_UINT32 = rgba(97, 184, 174); // light
+    constexpr uint32_t PIXEL_OFF_UINT32 = rgba(19, 23, 38);  // dark
 
-    constexpr uint32_t PIXEL_ON_UINT32 = sdlcolor_to_uint32(PIXEL_COLOR_ON); // light
-    constexpr uint32_t PIXEL_OFF_UINT32 = sdlcolor_to_uint32(PIXEL_COLOR_OFF);  // dark
+    // XO-CHIP colors, indexed by one bit per bitplane (plane 0 is bit 0).
+    //  Single-plane programs only ever see the first two.
+    constexpr uint32_t PALETTE[16] = {
+        PIXEL_OFF_UINT32,       // 0: background
+        PIXEL_ON_UINT32,        // 1: plane 0
+        rgba(230, 110, 75),     // 2: plane 1
+        rgba(245, 225, 160),    // 3: planes 0 and 1
+        rgba(60, 90, 170),
+        rgba(120, 200, 235),
+        rgba(170, 70, 140),
+        rgba(235, 150, 200),
+        rgba(70, 110, 60),
+        rgba(150, 210, 110),
+        rgba(140, 90, 50),
+        rgba(215, 175, 95),
+        rgba(80, 80, 95),
+        rgba(150, 150, 165),
+        rgba(200, 60, 60),
+        rgba(250, 250, 250),
+    };
 
-    constexpr uint16_t PIXEL_WIDTH = 64;     // width of window in logical pixels
-    constexpr uint16_t PIXEL_HEIGHT = 32;    // height of window in logical pixels
+    constexpr uint16_t PIXEL_WIDTH = 64;     // width of window in logical pixels (lores)
+    constexpr uint16_t PIXEL_HEIGHT = 32;    // height of window in logical pixels (lores)
+    constexpr uint16_t HIRES_WIDTH = 128;    // SUPER-CHIP / XO-CHIP hires mode
+    constexpr uint16_t HIRES_HEIGHT = 64;
     constexpr uint16_t DISPLAY_SCALE = 10;   // scale of logical pixels to screen pixels
 
     constexpr uint16_t WINDOW_WIDTH = DISPLAY_SCALE * PIXEL_WIDTH;
@@ -29,29 +58,36 @@ namespace Utils
 
 
     // Constants for memory addresses
-    constexpr uint16_t MEMORY_SIZE = 4096; 
+    constexpr uint32_t MEMORY_SIZE = 0x10000;   // XO-CHIP's 64K; the profile decides how much is addressable
     constexpr int MEMORY_START_ADDRESS = 0x000; 
-    constexpr int MEMORY_END_ADDRESS = 0xFFF; 
+    constexpr int MEMORY_END_ADDRESS = 0xFFFF; 
     constexpr int FONT_START_ADDRESS = 0x50;
+    constexpr int HIRES_FONT_START_ADDRESS = 0xA0;  // SUPER-CHIP 8x10 digits, right after the small font
     constexpr int PROGRAM_START_ADDRESS = 0x200;
     constexpr int STACK_DEPTH = 16;
+    constexpr int FLAG_REGISTERS = 16;  // SUPER-CHIP's RPL user flags (Fx75/Fx85)
 
     // Constants for timing
-    constexpr uint32_t CPU_CYCLE_HZ = 1000; // CPU instruction rate
+    constexpr uint32_t CPU_CYCLE_HZ = 1000; // Default CPU instruction rate
     constexpr uint32_t TIMER_CYCLE_HZ = 60; // Display refresh + timer ticks
+    constexpr uint32_t CYCLES_PER_FRAME = CPU_CYCLE_HZ / TIMER_CYCLE_HZ; // Default instruction budget per frame
 
     // Settings for Audio
     constexpr uint32_t AUDIO_RATE_HZ = 44100; // Audio sample rate
     constexpr uint32_t AUDIO_BUFFER_SIZE = 1024;
     constexpr float BEEP_TONE_HZ = 440.0f;
     constexpr float BEEP_AMPLITUDE = 0.05f;
+    constexpr size_t AUDIO_PATTERN_BYTES = 16;      // XO-CHIP 1-bit pattern buffer (128 samples)
+    constexpr float AUDIO_PATTERN_BASE_HZ = 4000.0f; // Pattern playback rate at the default pitch
+    constexpr uint8_t AUDIO_PATTERN_BASE_PITCH = 64;
 
-    // Key Mapping
-    const std::unordered_map<SDL_Keycode, uint8_t> KEY_MAPPING = {
-        {SDLK_1, 0x1}, {SDLK_2, 0x2}, {SDLK_3, 0x3}, {SDLK_4, 0xC},
-        {SDLK_q, 0x4}, {SDLK_w, 0x5}, {SDLK_e, 0x6}, {SDLK_r, 0xD},
-        {SDLK_a, 0x7}, {SDLK_s, 0x8}, {SDLK_d, 0x9}, {SDLK_f, 0xE},
-        {SDLK_z, 0xA}, {SDLK_x, 0x0}, {SDLK_c, 0xB}, {SDLK_v, 0xF} 
-    };
+    // Settings for Rewind
+    constexpr uint32_t REWIND_SECONDS = 300;            // History kept by default in the window
+    constexpr uint32_t REWIND_KEYFRAME_INTERVAL = 60;   // Frames between full snapshots
+    constexpr size_t REWIND_MAX_BYTES = 64 << 20;       // Hard cap on the history's memory
+
+    // Settings for Telemetry
+    constexpr uint32_t STATS_INTERVAL_SECONDS = 10;     // Between rewrites of the --stats file
+    constexpr uint32_t OVERLAY_REFRESH_MS = 250;        // Overlay redraw rate while no frames arrive
 
 }
\ No newline at end of file
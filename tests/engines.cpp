@@ -0,0 +1,186 @@
+// Every execution engine must run a program exactly as the interpreter
+//  does. Each ROM in roms/test runs under every profile with the same
+//  input, once per engine, and the machine state at the end is compared
+//  with the interpreter's: registers, stack, timers, memory and screen.
+
+#include "test.h"
+
+#include "emulator.h"
+#include "guest_profiler.h"
+#include "headless_backend.h"
+#include "lockstep.h"
+#include "save_state.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+
+constexpr uint64_t FRAMES = 600;
+constexpr uint32_t CYCLES_PER_FRAME = 500;     // Enough for the test suites to get through their checks
+constexpr size_t LANES = 8;
+
+constexpr std::array<Profile, 5> PROFILES = {Profile::Vip, Profile::Chip48, Profile::Schip11, Profile::XoChip, Profile::Modern};
+
+// How a run is carried out. Cached runs blocks with superinstructions
+//  fused in; Profiled is the interpreter feeding a guest profiler.
+enum class Engine { Interpreter, Profiled, Cached, Jit, Aot };
+
+struct EngineInfo {
+    Engine engine;
+    const char* name;
+};
+constexpr std::array<EngineInfo, 4> OTHER_ENGINES = {{
+    {Engine::Profiled, "profiled"},
+    {Engine::Cached, "cached"},
+    {Engine::Jit, "jit"},
+    {Engine::Aot, "aot"},
+}};
+
+// A few key presses spread over the run: 1 picks the first entry of the
+//  test suite menus, the rest go to Ex9E/ExA1/Fx0A
+const std::string& input_script() {
+    static const std::string path = [] {
+        std::filesystem::path script = std::filesystem::temp_directory_path() /
+                                       ("chip8-tests-input-" + std::to_string(getpid()) + ".txt");
+        std::ofstream out(script);
+        uint64_t frame = 60;
+        for (char key : std::string("1A52F0E37")) {
+            out << frame << ' ' << key << " down\n" << frame + 4 << ' ' << key << " up\n";
+            frame += 50;
+        }
+        return script.string();
+    }();
+    return path;
+}
+
+std::vector<std::string> test_roms() {
+    std::vector<std::string> roms;
+    for (const auto& entry : std::filesystem::directory_iterator("roms/test")) {
+        if (entry.path().extension() == ".ch8")
+            roms.push_back(entry.path().string());
+    }
+    std::sort(roms.begin(), roms.end());
+    return roms;
+}
+
+void append(std::vector<uint8_t>& bytes, const void* data, size_t size) {
+    const auto* begin = static_cast<const uint8_t*>(data);
+    bytes.insert(bytes.end(), begin, begin + size);
+}
+
+uint32_t hash_framebuffer(const Backend::Framebuffer& pixels) {
+    std::vector<uint8_t> bytes;
+    for (size_t plane = 0; plane < Backend::Framebuffer::PLANES; plane++) {
+        for (uint16_t y = 0; y < Backend::Framebuffer::ROWS; y++) {
+            append(bytes, pixels.row(plane, y).data(), sizeof(pixels.row(plane, y)));
+        }
+    }
+    return Utils::fnv1a(bytes.data(), bytes.size());
+}
+
+// Everything a program can observe, field by field (the structs have
+//  padding, so they aren't hashed whole)
+struct Result {
+    uint64_t frames;
+    uint64_t cycles;
+    uint32_t state_hash;
+    uint32_t framebuffer_hash;
+
+    bool operator==(const Result&) const = default;
+};
+
+Result run(const std::string& rom, Profile profile, Engine engine, uint32_t seed) {
+    Emulator emulator(std::make_unique<HeadlessBackend>(input_script()));
+    GuestProfiler profiler;
+    switch (engine) {
+        case Engine::Interpreter: emulator.set_cpu_engine(CPU::Engine::Interpreter); break;
+        case Engine::Profiled:    emulator.set_guest_profiler(&profiler); break;
+        case Engine::Cached:      emulator.set_cpu_engine(CPU::Engine::Cached); break;
+        case Engine::Jit:         emulator.set_cpu_engine(CPU::Engine::Jit); break;
+        case Engine::Aot:         emulator.set_cpu_engine(CPU::Engine::Aot); break;
+    }
+    emulator.set_profile(profile);
+    emulator.set_cycles_per_frame(CYCLES_PER_FRAME);
+    emulator.seed(seed);
+    emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+    emulator.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
+    emulator.load_rom(rom);
+    emulator.run(FRAMES);
+
+    auto state = std::make_unique<SaveState>();
+    emulator.save_state(*state);
+    const CPU::State& cpu = state->cpu;
+    std::vector<uint8_t> bytes;
+    append(bytes, &state->delay_timer, sizeof(state->delay_timer));
+    append(bytes, &state->sound_timer, sizeof(state->sound_timer));
+    append(bytes, cpu.v.data(), sizeof(cpu.v));
+    append(bytes, &cpu.i, sizeof(cpu.i));
+    append(bytes, &cpu.pc, sizeof(cpu.pc));
+    append(bytes, &cpu.sp, sizeof(cpu.sp));
+    append(bytes, cpu.stack.data(), cpu.sp * sizeof(cpu.stack[0]));
+    append(bytes, cpu.flags.data(), sizeof(cpu.flags));
+    append(bytes, &cpu.waiting_for_key, sizeof(cpu.waiting_for_key));
+    append(bytes, state->ram.data(), state->ram.size());
+
+    return Result{emulator.frame(), emulator.cycles(), Utils::fnv1a(bytes.data(), bytes.size()),
+                  hash_framebuffer(emulator.peripherals().framebuffer)};
+}
+
+std::string describe(const std::string& rom, Profile profile, const char* engine) {
+    return rom + " as " + profile_name(profile) + " on " + engine;
+}
+
+}
+
+TEST(engines_match_interpreter) {
+    for (const std::string& rom : test_roms()) {
+        for (Profile profile : PROFILES) {
+            Result expected = run(rom, profile, Engine::Interpreter, 1);
+            for (const EngineInfo& other : OTHER_ENGINES) {
+                CHECK_MSG(run(rom, profile, other.engine, 1) == expected, describe(rom, profile, other.name));
+            }
+        }
+    }
+}
+
+TEST(lockstep_matches_interpreter) {
+    if (!Lockstep<LANES>::supported())
+        return;
+
+    // Each lane has its own seed, so Cxnn sends them different ways
+    for (const std::string& rom : test_roms()) {
+        for (Profile profile : PROFILES) {
+            std::vector<std::unique_ptr<Backend>> backends;
+            for (size_t lane = 0; lane < LANES; lane++) {
+                backends.push_back(std::make_unique<HeadlessBackend>(input_script()));
+            }
+            Lockstep<LANES> lockstep(std::move(backends));
+            lockstep.set_profile(profile);
+            lockstep.set_cycles_per_frame(CYCLES_PER_FRAME);
+            lockstep.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+            lockstep.load_rom("roms/builtin/font-hires.ch8", Utils::HIRES_FONT_START_ADDRESS);
+            lockstep.load_rom(rom);
+            for (size_t lane = 0; lane < LANES; lane++) {
+                lockstep.seed(lane, lane + 1);
+            }
+            lockstep.run(FRAMES);
+
+            for (size_t lane = 0; lane < LANES; lane++) {
+                Result expected = run(rom, profile, Engine::Interpreter, lane + 1);
+                std::string context = describe(rom, profile, "lockstep") + " lane " + std::to_string(lane);
+                CHECK_MSG(lockstep.frames(lane) == expected.frames, context);
+                CHECK_MSG(lockstep.cycles(lane) == expected.cycles, context);
+                CHECK_MSG(hash_framebuffer(lockstep.framebuffer(lane)) == expected.framebuffer_hash, context);
+            }
+        }
+    }
+}
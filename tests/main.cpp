@@ -0,0 +1,57 @@
+#include "test.h"
+
+#include <cstdio>
+#include <exception>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct TestCase {
+    const char* name;
+    TestFn fn;
+};
+
+std::vector<TestCase>& registry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+int failures = 0;
+
+}
+
+bool register_test(const char* name, TestFn fn) {
+    registry().push_back({name, fn});
+    return true;
+}
+
+void report_failure(const char* file, int line, const std::string& message) {
+    std::fprintf(stderr, "%s:%d: FAILED %s\n", file, line, message.c_str());
+    failures++;
+}
+
+int main(int argc, char* argv[]) {
+    // ROMs and fonts are loaded relative to the source tree
+    std::string only = argc > 1 ? argv[1] : "";
+
+    size_t run = 0;
+    for (const TestCase& test : registry()) {
+        if (!only.empty() && only != test.name)
+            continue;
+        run++;
+        int before = failures;
+        try {
+            test.fn();
+        } catch (const std::exception& error) {
+            report_failure(__FILE__, __LINE__, std::string(test.name) + " threw: " + error.what());
+        }
+        std::printf("%s %s\n", failures == before ? "ok  " : "FAIL", test.name);
+    }
+
+    if (run == 0) {
+        std::fprintf(stderr, "No test named %s\n", only.c_str());
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// Classic profiles address 4K of memory and XO-CHIP 64K, on the same bus.
+//  Past the profile's size the access policy applies (chip8-tests is
+//  built with the checked bus, so it throws), whichever engine runs.
+//
+// tests/roms/past-4k.ch8 loads V0-V1 from the last byte of 4K onwards:
+//
+//   200: AFFF   I = FFF
+//   202: F165   V0 = [FFF], V1 = [1000]
+//   204: 1204   halt
+
+#include "test.h"
+
+#include "emulator.h"
+#include "headless_backend.h"
+#include "ram.h"
+
+#include <array>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+constexpr const char* ROM = "tests/roms/past-4k.ch8";
+
+bool runs_past_4k(CPU::Engine engine, Profile profile) {
+    Emulator emulator(std::make_unique<HeadlessBackend>());
+    emulator.set_cpu_engine(engine);
+    emulator.set_profile(profile);
+    emulator.load_rom(ROM);
+    try {
+        emulator.run(1);
+    } catch (const std::out_of_range&) {
+        return false;
+    }
+    return true;
+}
+
+}
+
+TEST(memory_size_follows_profile) {
+    constexpr std::array<CPU::Engine, 4> ENGINES = {CPU::Engine::Interpreter, CPU::Engine::Cached, CPU::Engine::Jit, CPU::Engine::Aot};
+    constexpr std::array<const char*, 4> NAMES = {"interpreter", "cached", "jit", "aot"};
+
+    for (Profile profile : {Profile::Vip, Profile::Chip48, Profile::Schip11, Profile::XoChip, Profile::Modern}) {
+        bool expected = profile_memory_size(profile) > 0x1000;
+        for (size_t engine = 0; engine < ENGINES.size(); engine++) {
+            CHECK_MSG(runs_past_4k(ENGINES[engine], profile) == expected,
+                      std::string(NAMES[engine]) + " as " + profile_name(profile));
+        }
+    }
+
+    // Memory that drops out of reach reads as zero when it comes back
+    RAM ram;
+    ram.set_size(profile_memory_size(Profile::XoChip));
+    ram.write(0x1234, 0xAB);
+    ram.set_size(profile_memory_size(Profile::Modern));
+    ram.set_size(profile_memory_size(Profile::XoChip));
+    CHECK(ram.read(0x1234) == 0);
+}
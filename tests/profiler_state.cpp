@@ -0,0 +1,55 @@
+// Loading a save state rebuilds the guest profiler's call stack from the
+//  CPU stack and the 2nnn instructions it points at. Whatever the state,
+//  the profiler must end up in the same place as one that ran there.
+
+#include "test.h"
+
+#include "emulator.h"
+#include "guest_profiler.h"
+#include "headless_backend.h"
+#include "save_state.h"
+#include "utilities.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace {
+
+constexpr const char* ROM = "roms/games/glitchGhost.ch8";
+constexpr uint64_t FRAMES = 300;
+constexpr uint32_t CYCLES_PER_FRAME = 7;   // Odd, so frames end all over the program
+
+void start(Emulator& emulator, GuestProfiler& profiler) {
+    emulator.set_guest_profiler(&profiler);
+    emulator.set_cycles_per_frame(CYCLES_PER_FRAME);
+    emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+    emulator.load_rom(ROM);
+}
+
+}
+
+TEST(profiler_stack_after_load_state) {
+    GuestProfiler straight_profiler;
+    Emulator straight(std::make_unique<HeadlessBackend>());
+    start(straight, straight_profiler);
+
+    GuestProfiler loaded_profiler;
+    Emulator loaded(std::make_unique<HeadlessBackend>());
+    start(loaded, loaded_profiler);
+
+    auto state = std::make_unique<SaveState>();
+    size_t deepest = 0;
+    for (uint64_t frame = 1; frame <= FRAMES; frame++) {
+        straight.run(frame);
+        straight.save_state(*state);
+        loaded.load_state(*state);
+
+        deepest = std::max<size_t>(deepest, state->cpu.sp);
+        CHECK_MSG(loaded_profiler.current_stack() == straight_profiler.current_stack(),
+                  "frame " + std::to_string(frame) + ": " + loaded_profiler.current_stack() + " vs " + straight_profiler.current_stack());
+    }
+
+    // The states must have covered nested calls for the check to mean much
+    CHECK(deepest >= 2);
+}
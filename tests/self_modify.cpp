@@ -0,0 +1,64 @@
+// Self-modifying code must be noticed by every engine, including after
+//  the profile changes once the ROM is loaded (as save states, movies and
+//  chip8's --profile do).
+//
+// tests/roms/self-modify.ch8 rewrites its own 6001 into 6008 with Fx55,
+//  then draws the digit V0 holds:
+//
+//   200: 6100   V1 = 0
+//   202: A209   I = 209 (the operand of the instruction at 208)
+//   204: 6008   V0 = 8
+//   206: F055   [209] = 8, so 208 now reads 6008
+//   208: 6001   V0 = 1 (as loaded)
+//   20A: F029   I = font digit V0
+//   20C: D115   draw it at 0,0
+//   20E: 120E   halt
+
+#include "test.h"
+
+#include "emulator.h"
+#include "headless_backend.h"
+#include "utilities.h"
+
+#include <array>
+#include <memory>
+#include <string>
+
+namespace {
+
+constexpr const char* ROM = "tests/roms/self-modify.ch8";
+constexpr size_t DIGIT_8_PIXELS = 16;  // F0 90 F0 90 F0
+
+size_t lit_pixels(CPU::Engine engine, Profile profile) {
+    Emulator emulator(std::make_unique<HeadlessBackend>());
+    emulator.set_cpu_engine(engine);
+    emulator.load_rom("roms/builtin/font.ch8", Utils::FONT_START_ADDRESS);
+    emulator.load_rom(ROM);
+    emulator.set_profile(profile);
+    emulator.run(2);
+
+    size_t lit = 0;
+    const Backend::Framebuffer& pixels = emulator.peripherals().framebuffer;
+    for (uint16_t y = 0; y < pixels.height(); y++) {
+        for (uint16_t x = 0; x < pixels.width(); x++) {
+            lit += pixels.pixel(x, y) != 0;
+        }
+    }
+    return lit;
+}
+
+}
+
+TEST(self_modify_after_profile_change) {
+    constexpr std::array<CPU::Engine, 4> ENGINES = {CPU::Engine::Interpreter, CPU::Engine::Cached, CPU::Engine::Jit, CPU::Engine::Aot};
+    constexpr std::array<const char*, 4> NAMES = {"interpreter", "cached", "jit", "aot"};
+
+    // Modern is the CPU's starting profile, so only the others change it.
+    //  The AOT program was attached by load_rom and must still be watched.
+    for (Profile profile : {Profile::Modern, Profile::Chip48, Profile::Schip11}) {
+        for (size_t engine = 0; engine < ENGINES.size(); engine++) {
+            CHECK_MSG(lit_pixels(ENGINES[engine], profile) == DIGIT_8_PIXELS,
+                      std::string(NAMES[engine]) + " as " + profile_name(profile));
+        }
+    }
+}
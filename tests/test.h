@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+// Minimal harness for the ctest targets. Each test file defines TEST()s,
+//  which register themselves by name; CHECK() reports a failure and keeps
+//  going, so one run lists every mismatch.
+//
+//   chip8-tests          runs every test
+//   chip8-tests <name>   runs one, as ctest does
+
+using TestFn = void (*)();
+bool register_test(const char* name, TestFn fn);
+void report_failure(const char* file, int line, const std::string& message);
+
+#define TEST(name)                                                              \
+    static void test_##name();                                                  \
+    [[maybe_unused]] static const bool registered_##name = register_test(#name, &test_##name); \
+    static void test_##name()
+
+#define CHECK(condition)                                                        \
+    do {                                                                        \
+        if (!(condition))                                                       \
+            report_failure(__FILE__, __LINE__, #condition);                     \
+    } while (0)
+
+// Like CHECK, with context for the failure message (which ROM, engine, ...)
+#define CHECK_MSG(condition, message)                                           \
+    do {                                                                        \
+        if (!(condition))                                                       \
+            report_failure(__FILE__, __LINE__, std::string(#condition) + ": " + (message)); \
+    } while (0)